@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include "BVH.h"
+
+// Surface area of a box, the probability measure used by the SAH
+static double surfaceArea(const Eigen::AlignedBox3d &box) {
+  if (box.isEmpty()) {
+    return 0;
+  }
+  Eigen::Vector3d e = box.sizes();
+  return 2 * (e.x() * e.y() + e.y() * e.z() + e.z() * e.x());
+}
+
+// Builds the hierarchy over a set of primitives
+void BVH::build(const std::vector<Eigen::AlignedBox3d> &primBounds) {
+  _nodes.clear();
+  _order.resize(primBounds.size());
+  std::iota(_order.begin(), _order.end(), 0);
+  if (primBounds.empty()) {
+    return;
+  }
+
+  std::vector<Eigen::Vector3d> centroids;
+  centroids.reserve(primBounds.size());
+  for (const auto &box : primBounds) {
+    centroids.push_back(box.center());
+  }
+
+  _nodes.reserve(2 * primBounds.size());
+  BVHNode root;
+  root.first = 0;
+  root.count = static_cast<unsigned int>(primBounds.size());
+  fitLeaf(root, primBounds);
+  _nodes.push_back(root);
+  subdivide(0, 0, primBounds, centroids);
+}
+
+// Recomputes the bounds of a node from its primitives
+void BVH::fitLeaf(BVHNode &node, const std::vector<Eigen::AlignedBox3d> &primBounds) const {
+  node.bounds.setEmpty();
+  for (unsigned int i = node.first; i < node.first + node.count; i++) {
+    node.bounds.extend(primBounds[_order[i]]);
+  }
+}
+
+// Recursively splits a node along the cheapest SAH plane
+void BVH::subdivide(unsigned int nodeIndex, int depth,
+                    const std::vector<Eigen::AlignedBox3d> &primBounds,
+                    const std::vector<Eigen::Vector3d> &centroids) {
+  const unsigned int first = _nodes[nodeIndex].first;
+  const unsigned int count = _nodes[nodeIndex].count;
+  if (count <= 2 || depth >= BVH_STACK - 1) {
+    return;
+  }
+
+  Eigen::AlignedBox3d centroidBounds;
+  for (unsigned int i = first; i < first + count; i++) {
+    centroidBounds.extend(centroids[_order[i]]);
+  }
+
+  // Evaluate the binned SAH on every axis
+  int bestAxis = -1;
+  int bestSplit = 0;
+  double bestCost = INFINITY;
+  for (int axis = 0; axis < 3; axis++) {
+    double lo = centroidBounds.min()[axis];
+    double extent = centroidBounds.max()[axis] - lo;
+    if (extent <= 0) {
+      continue;  // All centroids share this coordinate
+    }
+    double scale = BVH_BINS / extent;
+
+    Eigen::AlignedBox3d binBounds[BVH_BINS];
+    unsigned int binCount[BVH_BINS] = {0};
+    for (unsigned int i = first; i < first + count; i++) {
+      unsigned int p = _order[i];
+      int b = std::min(BVH_BINS - 1, static_cast<int>((centroids[p][axis] - lo) * scale));
+      binBounds[b].extend(primBounds[p]);
+      binCount[b]++;
+    }
+
+    // Sweep from the right to get the suffix areas, then from the left
+    double rightArea[BVH_BINS];
+    unsigned int rightCount[BVH_BINS];
+    Eigen::AlignedBox3d acc;
+    unsigned int n = 0;
+    for (int b = BVH_BINS - 1; b > 0; b--) {
+      acc.extend(binBounds[b]);
+      n += binCount[b];
+      rightArea[b] = surfaceArea(acc);
+      rightCount[b] = n;
+    }
+    acc.setEmpty();
+    n = 0;
+    for (int b = 0; b < BVH_BINS - 1; b++) {
+      acc.extend(binBounds[b]);
+      n += binCount[b];
+      if (n == 0 || rightCount[b + 1] == 0) {
+        continue;
+      }
+      double cost = n * surfaceArea(acc) + rightCount[b + 1] * rightArea[b + 1];
+      if (cost < bestCost) {
+        bestCost = cost;
+        bestAxis = axis;
+        bestSplit = b;
+      }
+    }
+  }
+
+  if (bestAxis < 0) {
+    return;  // Centroids coincide, nothing to split
+  }
+  // Compare against the cost of intersecting every primitive in this node
+  double leafCost = count * surfaceArea(_nodes[nodeIndex].bounds);
+  if (bestCost >= leafCost && count <= BVH_MAX_LEAF) {
+    return;
+  }
+
+  double lo = centroidBounds.min()[bestAxis];
+  double scale = BVH_BINS / (centroidBounds.max()[bestAxis] - lo);
+  auto middle = std::partition(_order.begin() + first, _order.begin() + first + count,
+                               [&](unsigned int p) {
+                                 int b = std::min(BVH_BINS - 1, static_cast<int>((centroids[p][bestAxis] - lo) * scale));
+                                 return b <= bestSplit;
+                               });
+  unsigned int leftCount = static_cast<unsigned int>(middle - (_order.begin() + first));
+
+  BVHNode left, right;
+  left.first = first;
+  left.count = leftCount;
+  right.first = first + leftCount;
+  right.count = count - leftCount;
+  fitLeaf(left, primBounds);
+  fitLeaf(right, primBounds);
+
+  unsigned int leftIndex = static_cast<unsigned int>(_nodes.size());
+  _nodes.push_back(left);
+  _nodes.push_back(right);
+  _nodes[nodeIndex].first = leftIndex;
+  _nodes[nodeIndex].count = 0;
+
+  subdivide(leftIndex, depth + 1, primBounds, centroids);
+  subdivide(leftIndex + 1, depth + 1, primBounds, centroids);
+}
+
+// Retrieves the primitive order chosen by the builder
+const std::vector<unsigned int> &BVH::order() const {
+  return _order;
+}
+
+// Slab test of a ray against a node's bounds
+bool BVH::slab(const BVHNode &node, const Eigen::Vector3d &orig,
+               const Eigen::Vector3d &invDir, double tMax, double &tEntry) {
+  Eigen::Array3d t0 = (node.bounds.min() - orig).array() * invDir.array();
+  Eigen::Array3d t1 = (node.bounds.max() - orig).array() * invDir.array();
+  double tNear = t0.min(t1).maxCoeff();
+  double tFar = t0.max(t1).minCoeff();
+  tEntry = std::max(tNear, 0.0);
+  return tEntry <= std::min(tFar, tMax);
+}
+
+// Slab test of a packet against a node's bounds
+uint64_t BVH::slab(const BVHNode &node, const RayPacket &packet, uint64_t mask, float &tEntry) {
+  float lo[3], hi[3], o[3];
+  for (int a = 0; a < 3; a++) {
+    o[a] = static_cast<float>(packet.origin[a]);
+    lo[a] = static_cast<float>(node.bounds.min()[a]) - o[a];
+    hi[a] = static_cast<float>(node.bounds.max()[a]) - o[a];
+  }
+
+  // Interval arithmetic over the packet's inverse directions bounds every ray's entry and exit
+  float entryBound = 0, exitBound = INFINITY;
+  for (int a = 0; a < 3; a++) {
+    if (!packet.coherent[a]) {
+      continue;
+    }
+    float nearPlane = packet.invMin[a] > 0 ? lo[a] : hi[a];
+    float farPlane = packet.invMin[a] > 0 ? hi[a] : lo[a];
+    entryBound = std::max(entryBound, std::min(nearPlane * packet.invMin[a], nearPlane * packet.invMax[a]));
+    exitBound = std::min(exitBound, std::max(farPlane * packet.invMin[a], farPlane * packet.invMax[a]));
+  }
+  if (entryBound > exitBound) {
+    return 0;  // The whole frustum misses the box
+  }
+
+  // Exact test of the remaining rays, SIMD_WIDTH at a time
+  const floatv zero = broadcast(0.0f);
+  floatv lowV[3], highV[3];
+  for (int a = 0; a < 3; a++) {
+    lowV[a] = broadcast(lo[a]);
+    highV[a] = broadcast(hi[a]);
+  }
+
+  uint64_t result = 0;
+  float entry = INFINITY;
+  for (int g = 0; g < PACKET_LANES; g += SIMD_WIDTH) {
+    if ((mask >> g & ((uint64_t(1) << SIMD_WIDTH) - 1)) == 0) {
+      continue;
+    }
+    floatv tNear = zero, tFar = load(packet.t + g);
+    for (int a = 0; a < 3; a++) {
+      floatv inv = load(packet.invDir[a] + g);
+      floatv t0 = lowV[a] * inv, t1 = highV[a] * inv;
+      tNear = max(tNear, min(t0, t1));
+      tFar = min(tFar, max(t0, t1));
+    }
+    uint64_t hit = static_cast<uint64_t>(bits(tNear <= tFar)) << g & mask;
+    result |= hit;
+
+    float nearLanes[SIMD_WIDTH];
+    store(nearLanes, tNear);
+    for (; hit != 0; hit &= hit - 1) {
+      entry = std::min(entry, nearLanes[__builtin_ctzll(hit) - g]);
+    }
+  }
+
+  tEntry = entry;
+  return result;
+}
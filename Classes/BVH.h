@@ -0,0 +1,300 @@
+#ifndef _BVH_H_
+#define _BVH_H_
+
+#include <vector>
+#include <Eigen/Dense>
+#include "RayPacket.h"
+
+#define BVH_BINS 16       // Number of centroid bins evaluated per axis by the SAH builder
+#define BVH_MAX_LEAF 8    // Leaves larger than this are split even if SAH prefers not to
+#define BVH_STACK 64      // Depth of the traversal stack
+
+/**
+ * @brief A node of the bounding volume hierarchy.
+ * Inner nodes store the index of their left child in `first` (the right child
+ * always follows it), leaves store the range [first, first + count) of
+ * primitives in BVH order.
+ */
+struct BVHNode {
+  Eigen::AlignedBox3d bounds;  ///< Bounds of everything below this node
+  unsigned int first = 0;      ///< Left child index, or first primitive for leaves
+  unsigned int count = 0;      ///< Number of primitives, 0 for inner nodes
+
+  bool isLeaf() const { return count > 0; }
+};
+
+/**
+ * @brief Bounding volume hierarchy built with a binned surface area heuristic.
+ * The hierarchy only knows about primitive bounds; the owner reorders its
+ * primitives with `order()` after building so that every leaf covers a
+ * contiguous range, and supplies the actual primitive test during traversal.
+ */
+class BVH {
+ private:
+  std::vector<BVHNode> _nodes;       ///< Flattened nodes, root at index 0
+  std::vector<unsigned int> _order;  ///< BVH position -> original primitive index
+
+  /**
+   * @brief Recursively splits a node along the cheapest SAH plane.
+   * @param nodeIndex The node to split.
+   * @param depth Depth of the node, bounded by the traversal stack.
+   * @param primBounds Bounds of every primitive, by original index.
+   * @param centroids Centroids of every primitive, by original index.
+   */
+  void subdivide(unsigned int nodeIndex, int depth,
+                 const std::vector<Eigen::AlignedBox3d> &primBounds,
+                 const std::vector<Eigen::Vector3d> &centroids);
+
+  /**
+   * @brief Recomputes the bounds of a node from its primitives.
+   * @param node The node to update.
+   * @param primBounds Bounds of every primitive, by original index.
+   */
+  void fitLeaf(BVHNode &node, const std::vector<Eigen::AlignedBox3d> &primBounds) const;
+
+  /**
+   * @brief Slab test of a ray against a node's bounds.
+   * @param node The node to test.
+   * @param orig The origin point of the ray.
+   * @param invDir The component-wise inverse of the ray direction.
+   * @param tMax The far end of the ray interval.
+   * @param tEntry Receives the distance at which the ray enters the bounds.
+   * @return True if the ray interval overlaps the bounds.
+   */
+  static bool slab(const BVHNode &node, const Eigen::Vector3d &orig,
+                   const Eigen::Vector3d &invDir, double tMax, double &tEntry);
+
+  /**
+   * @brief Slab test of a packet against a node's bounds.
+   * A conservative interval-arithmetic frustum test rejects nodes missed by
+   * the whole packet first; the survivors are tested ray by ray in SIMD.
+   * @param node The node to test.
+   * @param packet The packet, prepared.
+   * @param mask The rays to test.
+   * @param tEntry Receives the smallest entry distance among the rays that hit.
+   * @return The rays of mask whose interval overlaps the bounds.
+   */
+  static uint64_t slab(const BVHNode &node, const RayPacket &packet, uint64_t mask, float &tEntry);
+
+ public:
+  /**
+   * @brief Builds the hierarchy over a set of primitives.
+   * @param primBounds Bounds of every primitive.
+   */
+  void build(const std::vector<Eigen::AlignedBox3d> &primBounds);
+
+  /**
+   * @brief Retrieves the primitive order chosen by the builder.
+   * @return For every BVH position, the original index of the primitive stored there.
+   */
+  const std::vector<unsigned int> &order() const;
+
+  /**
+   * @brief Finds the closest hit along a ray.
+   * Children are visited front to back and subtrees entered beyond the
+   * current closest hit are skipped.
+   * @param orig The origin point of the ray.
+   * @param dir The direction of the ray.
+   * @param tMax The far end of the ray interval, shrunk to the closest hit.
+   * @param leafTest Callable `bool(unsigned first, unsigned count, double &tMax)`
+   *        testing a range of primitives (in BVH order) and shrinking tMax on a hit.
+   * @param root The node to start from, the whole hierarchy by default.
+   * @return True if any primitive was hit.
+   */
+  template <typename LeafTest>
+  bool intersect(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir,
+                 double &tMax, LeafTest &&leafTest, unsigned int root = 0) const;
+
+  /**
+   * @brief Checks whether a ray hits anything, stopping at the first primitive found.
+   * Children are still visited front to back, so a nearby occluder tends to
+   * be found first, but no hit shortens the ray and the first one ends the walk.
+   * @param orig The origin point of the ray.
+   * @param dir The direction of the ray.
+   * @param tMax The far end of the ray interval.
+   * @param leafTest Callable `bool(unsigned first, unsigned count)` checking whether
+   *        the ray hits a range of primitives (in BVH order) before tMax.
+   * @param root The node to start from, the whole hierarchy by default.
+   * @return True if any primitive was hit.
+   */
+  template <typename LeafTest>
+  bool occluded(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir,
+                double tMax, LeafTest &&leafTest, unsigned int root = 0) const;
+
+  /**
+   * @brief Finds the closest hit of every ray of a packet.
+   * The packet descends together, carrying the mask of rays still inside
+   * each node. Once a subtree is left with PACKET_SPLIT rays or fewer the
+   * packet splits and those rays finish it on their own.
+   * @param packet The packet, prepared.
+   * @param leafTest Callable `void(unsigned first, unsigned count, uint64_t mask)`
+   *        testing a range of primitives against the masked rays of the packet.
+   * @param rayTest Callable `void(unsigned ray, unsigned node)` tracing one ray
+   *        of the packet through the subtree below node.
+   */
+  template <typename LeafTest, typename RayTest>
+  void intersect(RayPacket &packet, LeafTest &&leafTest, RayTest &&rayTest) const;
+};
+
+template <typename LeafTest>
+bool BVH::intersect(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir,
+                    double &tMax, LeafTest &&leafTest, unsigned int root) const {
+  if (_nodes.empty()) {
+    return false;
+  }
+
+  const Eigen::Vector3d invDir = dir.cwiseInverse();
+  unsigned int stack[BVH_STACK];
+  double stackEntry[BVH_STACK];
+  int top = 0;
+  bool hit = false;
+
+  double tEntry;
+  if (!slab(_nodes[root], orig, invDir, tMax, tEntry)) {
+    return false;
+  }
+
+  unsigned int current = root;
+  while (true) {
+    const BVHNode &node = _nodes[current];
+    if (node.isLeaf()) {
+      hit |= leafTest(node.first, node.count, tMax);
+    } else {
+      double tLeft, tRight;
+      bool hitLeft = slab(_nodes[node.first], orig, invDir, tMax, tLeft);
+      bool hitRight = slab(_nodes[node.first + 1], orig, invDir, tMax, tRight);
+
+      if (hitLeft && hitRight) {
+        // Descend into the nearer child, defer the farther one
+        bool leftFirst = tLeft <= tRight;
+        stack[top] = leftFirst ? node.first + 1 : node.first;
+        stackEntry[top++] = leftFirst ? tRight : tLeft;
+        current = leftFirst ? node.first : node.first + 1;
+        continue;
+      }
+      if (hitLeft || hitRight) {
+        current = hitLeft ? node.first : node.first + 1;
+        continue;
+      }
+    }
+
+    // Pop the next subtree that can still contain a closer hit
+    bool found = false;
+    while (top > 0) {
+      --top;
+      if (stackEntry[top] <= tMax) {
+        current = stack[top];
+        found = true;
+        break;
+      }
+    }
+    if (!found) {
+      break;
+    }
+  }
+  return hit;
+}
+
+template <typename LeafTest>
+bool BVH::occluded(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir,
+                   double tMax, LeafTest &&leafTest, unsigned int root) const {
+  if (_nodes.empty()) {
+    return false;
+  }
+
+  const Eigen::Vector3d invDir = dir.cwiseInverse();
+  unsigned int stack[BVH_STACK];
+  int top = 0;
+
+  double tEntry;
+  if (!slab(_nodes[root], orig, invDir, tMax, tEntry)) {
+    return false;
+  }
+
+  unsigned int current = root;
+  while (true) {
+    const BVHNode &node = _nodes[current];
+    if (node.isLeaf()) {
+      if (leafTest(node.first, node.count)) {
+        return true;  // Any hit will do
+      }
+    } else {
+      double tLeft, tRight;
+      bool hitLeft = slab(_nodes[node.first], orig, invDir, tMax, tLeft);
+      bool hitRight = slab(_nodes[node.first + 1], orig, invDir, tMax, tRight);
+
+      if (hitLeft && hitRight) {
+        bool leftFirst = tLeft <= tRight;
+        stack[top++] = leftFirst ? node.first + 1 : node.first;
+        current = leftFirst ? node.first : node.first + 1;
+        continue;
+      }
+      if (hitLeft || hitRight) {
+        current = hitLeft ? node.first : node.first + 1;
+        continue;
+      }
+    }
+
+    // The interval never shrinks, so every deferred subtree is still worth a look
+    if (top == 0) {
+      return false;
+    }
+    current = stack[--top];
+  }
+}
+
+template <typename LeafTest, typename RayTest>
+void BVH::intersect(RayPacket &packet, LeafTest &&leafTest, RayTest &&rayTest) const {
+  if (_nodes.empty()) {
+    return;
+  }
+
+  unsigned int stack[BVH_STACK];
+  uint64_t stackMask[BVH_STACK];
+  int top = 0;
+
+  float tEntry;
+  uint64_t mask = slab(_nodes[0], packet, packet.active, tEntry);
+  unsigned int current = 0;
+
+  while (mask != 0) {
+    const BVHNode &node = _nodes[current];
+    if (__builtin_popcountll(mask) <= PACKET_SPLIT) {
+      // Too few rays left to share the traversal, split the packet
+      for (uint64_t rays = mask; rays != 0; rays &= rays - 1) {
+        rayTest(static_cast<unsigned int>(__builtin_ctzll(rays)), current);
+      }
+    } else if (node.isLeaf()) {
+      leafTest(node.first, node.count, mask);
+    } else {
+      float tLeft, tRight;
+      uint64_t maskLeft = slab(_nodes[node.first], packet, mask, tLeft);
+      uint64_t maskRight = slab(_nodes[node.first + 1], packet, mask, tRight);
+
+      if (maskLeft != 0 && maskRight != 0) {
+        // Descend into the child the packet reaches first, defer the other
+        bool leftFirst = tLeft <= tRight;
+        stack[top] = leftFirst ? node.first + 1 : node.first;
+        stackMask[top++] = leftFirst ? maskRight : maskLeft;
+        current = leftFirst ? node.first : node.first + 1;
+        mask = leftFirst ? maskLeft : maskRight;
+        continue;
+      }
+      if (maskLeft != 0 || maskRight != 0) {
+        current = maskLeft != 0 ? node.first : node.first + 1;
+        mask = maskLeft | maskRight;
+        continue;
+      }
+    }
+
+    // Pop the next subtree, dropping the rays that found a closer hit meanwhile
+    mask = 0;
+    while (top > 0 && mask == 0) {
+      --top;
+      current = stack[top];
+      mask = slab(_nodes[current], packet, stackMask[top], tEntry);
+    }
+  }
+}
+
+#endif //_BVH_H_
@@ -0,0 +1,145 @@
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "Batch.h"
+
+// What a frame is written as
+enum class Format { Text, PGM, PPM };
+
+// Picks the format from the extension of the output pattern
+static bool formatOf(const std::string &pattern, Format &format) {
+  auto endsWith = [&](const char *extension) {
+    std::string suffix(extension);
+    return pattern.size() >= suffix.size() && pattern.compare(pattern.size() - suffix.size(), suffix.size(), suffix) == 0;
+  };
+  if (endsWith(".txt")) {
+    format = Format::Text;
+  } else if (endsWith(".pgm")) {
+    format = Format::PGM;
+  } else if (endsWith(".ppm")) {
+    format = Format::PPM;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Puts the frame number in place of the pattern's only %d, %Nd or %0Nd; %% stands for %
+static bool framePath(const std::string &pattern, unsigned int frame, std::string &path) {
+  path.clear();
+  int numbers = 0;
+  for (size_t i = 0; i < pattern.size(); i++) {
+    if (pattern[i] != '%') {
+      path.push_back(pattern[i]);
+      continue;
+    }
+    if (i + 1 < pattern.size() && pattern[i + 1] == '%') {
+      path.push_back('%');
+      i++;
+      continue;
+    }
+    size_t end = i + 1;
+    bool zeros = end < pattern.size() && pattern[end] == '0';
+    int width = 0;
+    while (end < pattern.size() && std::isdigit(static_cast<unsigned char>(pattern[end])) && width < 100) {
+      width = width * 10 + (pattern[end++] - '0');
+    }
+    if (end >= pattern.size() || pattern[end] != 'd') {
+      return false;
+    }
+    std::string number = std::to_string(frame);
+    if (static_cast<int>(number.size()) < width) {
+      path.append(width - number.size(), zeros ? '0' : ' ');
+    }
+    path += number;
+    numbers++;
+    i = end;
+  }
+  return numbers == 1;
+}
+
+// Writes a whole file, replacing any file at the path
+static bool writeFile(const std::string &path, const char *data, size_t size) {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(data, static_cast<std::streamsize>(size));
+  return static_cast<bool>(out);
+}
+
+// Renders a range of frames to files without a terminal
+int runBatch(const Model &model, const BatchJob &job) {
+  Format format;
+  std::string path;
+  if (!formatOf(job.pattern, format) || !framePath(job.pattern, job.first, path)) {
+    std::cerr << "The output of a batch needs one %d for the frame number and a .txt, .pgm or .ppm extension: "
+              << job.pattern << std::endl;
+    return EXIT_FAILURE;
+  }
+  int width = job.width, height = job.height;
+  if (width <= 0 || height <= 0) {
+    static const int textSize[] = {BATCH_TEXT_SIZE}, imageSize[] = {BATCH_IMAGE_SIZE};
+    const int *size = format == Format::Text ? textSize : imageSize;
+    width = size[0];
+    height = size[1];
+  }
+  Canvas canvas(height, width);
+  if (format != Format::Text) {
+    canvas.setAspectRatio(height * CHAR_DIM / static_cast<float>(width));  // Square pixels
+  }
+
+  // One camera per thread, each tracing its tiles itself since the shared pool is busy with whole frames
+  ThreadPool &pool = ThreadPool::shared();
+  std::vector<std::unique_ptr<ThreadPool>> serial(pool.size());
+  std::vector<std::unique_ptr<Camera>> cameras(pool.size());
+  std::vector<std::string> paths(pool.size()), images(pool.size());
+  std::atomic<bool> failed(false);
+
+  auto start = std::chrono::steady_clock::now();
+  pool.parallelFor(job.count, [&](unsigned int task, unsigned int thread) {
+    if (failed) {
+      return;
+    }
+    if (!cameras[thread]) {
+      serial[thread].reset(new ThreadPool(1));
+      cameras[thread].reset(new Camera(model, job.origin, canvas, *serial[thread]));
+      cameras[thread]->setRenderMode(job.mode);
+      cameras[thread]->setShadows(job.shadows);
+      if (format == Format::Text) {
+        cameras[thread]->setGlyphMode(job.glyphs);
+        cameras[thread]->setOutlines(job.outlines);
+      }
+    }
+    Camera &camera = *cameras[thread];
+
+    // Turning the camera and its light against the model's rotation gives the same view as rotating the model
+    unsigned int frame = job.first + task;
+    camera.setOrigin(Eigen::AngleAxisd(-job.step * frame, Eigen::Vector3d::UnitZ()) * job.origin);
+    camera.rayTrace();
+
+    std::string &file = paths[thread];
+    framePath(job.pattern, frame, file);
+    bool written;
+    if (format == Format::Text) {
+      written = writeFile(file, camera.canvas().data(), camera.canvas().size());
+    } else {
+      camera.drawImage(images[thread], format == Format::PPM);
+      written = writeFile(file, images[thread].data(), images[thread].size());
+    }
+    if (!written && !failed.exchange(true)) {
+      std::cerr << "Failed to write " << file << std::endl;
+    }
+  });
+  std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+  if (failed) {
+    return EXIT_FAILURE;
+  }
+  std::cout << "Rendered " << job.count << " frames of " << width << "x" << height << " on " << pool.size()
+            << " threads in " << seconds.count() << " s, " << job.count / seconds.count() << " frames/s"
+            << std::endl;
+  return EXIT_SUCCESS;
+}
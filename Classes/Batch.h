@@ -0,0 +1,44 @@
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+#include <string>
+#include "Camera.h"
+
+#define BATCH_STEP (M_PI / 20)      // Rotation of the model from one frame to the next, as in the interactive loop
+#define BATCH_TEXT_SIZE 160, 48     // Default columns and rows of a text frame, in cells
+#define BATCH_IMAGE_SIZE 640, 480   // Default width and height of an image frame, in pixels
+
+/**
+ * @brief A range of frames of the rotating model to render to files.
+ */
+struct BatchJob {
+  std::string pattern;           ///< Output path with one %d, or %0Nd, for the frame number; its extension picks the format
+  unsigned int first = 0;        ///< First frame rendered
+  unsigned int count = 40;       ///< Frames rendered, a full turn by default
+  int width = 0;                 ///< Columns of a text frame or pixels of an image row, 0 for the format's default
+  int height = 0;                ///< Rows of a text frame or of an image, 0 for the format's default
+  double step = BATCH_STEP;      ///< Rotation about the z-axis from one frame to the next, in radians
+  Eigen::Vector3d origin{CAMERA_ORIGIN}; ///< Camera position at frame 0
+  GlyphMode glyphs = GlyphMode::Ascii;   ///< How the samples of a text cell become a character
+  RenderMode mode = RenderMode::Packet;  ///< How primary visibility is computed
+  bool shadows = false;                  ///< Whether the model casts hard shadows
+  bool outlines = false;                 ///< Whether text frames outline silhouettes and creases
+};
+
+/**
+ * @brief Renders a range of frames to files without a terminal.
+ * Frame k shows the model as the interactive loop does after k rotations.
+ * Rather than rotating the shared model, each frame turns the camera and
+ * its light the other way, so frames are independent and whole frames
+ * are spread over the shared thread pool, each thread tracing with a
+ * camera of its own. A pattern ending in .txt writes the characters of
+ * the canvas, .pgm a greyscale image and .ppm a colour one with one pixel
+ * per sample, square pixels and the same vertical field of view as the
+ * terminal. Throughput is printed when done.
+ * @param model The model to render, only read.
+ * @param job The frames to render and where to write them.
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the job is invalid or a frame could not be written.
+ */
+int runBatch(const Model &model, const BatchJob &job);
+
+#endif //_BATCH_H_
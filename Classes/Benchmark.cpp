@@ -0,0 +1,225 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "Benchmark.h"
+#include "Model.h"
+
+// Milliseconds elapsed while running fn
+template <typename Fn>
+static double timeMs(Fn &&fn) {
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Writes a UV sphere of rings x 2 * rings faces as OBJ text
+static std::string sphereOBJ(int rings) {
+  std::ostringstream obj;
+  int segments = 2 * rings;
+  obj << "o Sphere" << rings << "\n";
+  obj << "v 0 0 1\nv 0 0 -1\n";
+  for (int r = 1; r < rings; r++) {
+    double theta = M_PI * r / rings;
+    for (int s = 0; s < segments; s++) {
+      double phi = 2 * M_PI * s / segments;
+      obj << "v " << std::sin(theta) * std::cos(phi) << " " << std::sin(theta) * std::sin(phi) << " "
+          << std::cos(theta) << "\n";
+    }
+  }
+
+  // Vertex 1 is the north pole, 2 the south pole, then ring after ring; one normal per face
+  auto ring = [&](int r, int s) { return 3 + (r - 1) * segments + (s % segments); };
+  int normal = 0;
+  for (int r = 0; r < rings; r++) {
+    double theta = M_PI * (r + 0.5) / rings;
+    for (int s = 0; s < segments; s++) {
+      double phi = 2 * M_PI * (s + 0.5) / segments;
+      obj << "vn " << std::sin(theta) * std::cos(phi) << " " << std::sin(theta) * std::sin(phi) << " "
+          << std::cos(theta) << "\n";
+      normal++;
+      obj << "f ";
+      if (r == 0) {
+        obj << 1 << "//" << normal << " " << ring(1, s) << "//" << normal << " " << ring(1, s + 1) << "//" << normal;
+      } else if (r == rings - 1) {
+        obj << ring(r, s) << "//" << normal << " " << 2 << "//" << normal << " " << ring(r, s + 1) << "//" << normal;
+      } else {
+        obj << ring(r, s) << "//" << normal << " " << ring(r + 1, s) << "//" << normal << " "
+            << ring(r + 1, s + 1) << "//" << normal << " " << ring(r, s + 1) << "//" << normal;
+      }
+      obj << "\n";
+    }
+  }
+  return obj.str();
+}
+
+// Bounding sphere of a mesh's vertices
+static void boundingSphere(const Mesh &mesh, Eigen::Vector3d &center, double &radius) {
+  Eigen::AlignedBox3d bounds;
+  for (unsigned int i = 0; i < mesh.vertexCount(); i++) {
+    bounds.extend(mesh.position(i));
+  }
+  center = bounds.center();
+  radius = std::max(bounds.sizes().norm() / 2, 1e-9);
+}
+
+// A square of rays aimed at a sphere from outside it
+static void aimRays(const Eigen::Vector3d &center, double radius, Eigen::Vector3d &origin,
+                    std::vector<Eigen::Vector3d> &dirs) {
+  origin = center + radius * Eigen::Vector3d(2.5, 2, 1.5);
+  Eigen::Vector3d forward = (center - origin).normalized();
+  Eigen::Vector3d right = forward.cross(Eigen::Vector3d::UnitZ()).normalized();
+  Eigen::Vector3d up = right.cross(forward);
+  dirs.clear();
+  for (int y = 0; y < BENCH_RAYS; y++) {
+    for (int x = 0; x < BENCH_RAYS; x++) {
+      double sx = 2.0 * (x + 0.5) / BENCH_RAYS - 1, sy = 2.0 * (y + 0.5) / BENCH_RAYS - 1;
+      dirs.push_back(center + radius * (sx * right + sy * up) - origin);
+    }
+  }
+}
+
+// Intersects one mesh with every accelerator and prints a row of the table
+static void benchmarkModel(const std::string &name, std::istream &objectFile) {
+  Model model(objectFile);
+  const Mesh &mesh = model.mesh();
+
+  double bvhMs = timeMs([&] { model.buildAccelerator(); });
+  double gridMs = timeMs([&] { model.buildGrid(); });
+
+  Eigen::Vector3d center, origin;
+  double radius;
+  std::vector<Eigen::Vector3d> dirs;
+  boundingSphere(mesh, center, radius);
+  aimRays(center, radius, origin, dirs);
+
+  const Accelerator accelerators[] = {Accelerator::None, Accelerator::BVH, Accelerator::Grid};
+  const bool brute = mesh.triangleCount() <= BENCH_BRUTE_LIMIT;
+  std::vector<Hit> reference(dirs.size());
+  std::vector<bool> referenceHit(dirs.size());
+  char row[256];
+  std::snprintf(row, sizeof(row), "%-12s %9u %9.2f %9.2f", name.c_str(), mesh.triangleCount(), bvhMs, gridMs);
+  std::cout << row;
+
+  for (Accelerator accelerator : accelerators) {
+    if (accelerator == Accelerator::None && !brute) {
+      std::snprintf(row, sizeof(row), " %12s %9s", "-", "-");
+      std::cout << row;
+      continue;
+    }
+    model.setAccelerator(accelerator);
+    std::vector<Hit> hits(dirs.size());
+    std::vector<bool> found(dirs.size());
+    double ms = timeMs([&] {
+      for (size_t r = 0; r < dirs.size(); r++) {
+        found[r] = model.intersectObject(origin, dirs[r], hits[r]);
+      }
+    });
+
+    // The first accelerator run is the reference for the others
+    unsigned int mismatches = 0;
+    if (accelerator == Accelerator::None || (accelerator == Accelerator::BVH && !brute)) {
+      reference = hits;
+      referenceHit = found;
+    } else {
+      for (size_t r = 0; r < dirs.size(); r++) {
+        if (found[r] != referenceHit[r] ||
+            (found[r] && std::fabs(hits[r].t - reference[r].t) > 1e-4 * reference[r].t)) {
+          mismatches++;
+        }
+      }
+    }
+    std::snprintf(row, sizeof(row), " %12.3f %9u", dirs.size() / (ms * 1000), mismatches);
+    std::cout << row;
+  }
+  std::cout << std::endl;
+}
+
+// Deforms one mesh every frame through the BVH and the grid and prints a row of the second table
+static void benchmarkDeformation(const std::string &name, std::istream &objectFile) {
+  Model model(objectFile);
+  const Mesh &mesh = model.mesh();
+  Eigen::Vector3d center, origin;
+  double radius;
+  std::vector<Eigen::Vector3d> dirs;
+  boundingSphere(mesh, center, radius);
+  aimRays(center, radius * (1 + BENCH_WOBBLE), origin, dirs);
+
+  // Waves running along z push the vertices in and out from the centre
+  std::vector<Eigen::Vector3d> rest(mesh.vertexCount()), positions(mesh.vertexCount());
+  for (unsigned int i = 0; i < mesh.vertexCount(); i++) {
+    rest[i] = mesh.position(i);
+  }
+  auto deform = [&](int frame) {
+    for (size_t i = 0; i < rest.size(); i++) {
+      Eigen::Vector3d offset = rest[i] - center;
+      double wave = std::sin(6 * offset.z() / radius + 2 * M_PI * frame / BENCH_FRAMES);
+      positions[i] = center + (1 + BENCH_WOBBLE * wave) * offset;
+    }
+  };
+
+  // Distance to the closest hit of every ray in every frame, INFINITY for a miss
+  const Accelerator accelerators[] = {Accelerator::BVH, Accelerator::Grid};
+  std::vector<double> depths[2];
+  double ms[2] = {0, 0};
+  for (int a = 0; a < 2; a++) {
+    model.setAccelerator(accelerators[a]);
+    depths[a].resize(BENCH_FRAMES * dirs.size());
+    for (int frame = 0; frame < BENCH_FRAMES; frame++) {
+      deform(frame);
+      ms[a] += timeMs([&] {
+        model.setVertexPositions(positions);
+        for (size_t r = 0; r < dirs.size(); r++) {
+          Hit hit;
+          depths[a][frame * dirs.size() + r] = model.intersectObject(origin, dirs[r], hit) ? hit.t : INFINITY;
+        }
+      });
+    }
+  }
+
+  unsigned int mismatches = 0;
+  for (size_t k = 0; k < depths[0].size(); k++) {
+    if (std::isinf(depths[0][k]) != std::isinf(depths[1][k]) ||
+        (!std::isinf(depths[0][k]) && std::fabs(depths[1][k] - depths[0][k]) > 1e-4 * depths[0][k])) {
+      mismatches++;
+    }
+  }
+  char row[256];
+  std::snprintf(row, sizeof(row), "%-12s %9u %12.2f %12.2f %9u", name.c_str(), mesh.triangleCount(),
+                ms[0] / BENCH_FRAMES, ms[1] / BENCH_FRAMES, mismatches);
+  std::cout << row << std::endl;
+}
+
+// Compares the ray accelerators on a set of meshes
+int runBenchmark(const std::vector<std::string> &paths) {
+  char header[256];
+  std::snprintf(header, sizeof(header), "%-12s %9s %9s %9s %12s %9s %12s %9s %12s %9s", "mesh", "triangles",
+                "bvh ms", "grid ms", "none Mray/s", "diff", "bvh Mray/s", "diff", "grid Mray/s", "diff");
+  std::cout << header << std::endl;
+
+  for (const std::string &path : paths) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+      std::cerr << "Unable to open file " << path << std::endl;
+      return EXIT_FAILURE;
+    }
+    benchmarkModel(path.substr(path.find_last_of('/') + 1), file);
+  }
+  for (int rings : {16, 64, 256}) {
+    std::istringstream sphere(sphereOBJ(rings));
+    benchmarkModel("sphere" + std::to_string(rings), sphere);
+  }
+
+  // Every frame moves the vertices, so an accelerator pays for its update each time
+  std::snprintf(header, sizeof(header), "\n%-12s %9s %12s %12s %9s", "deforming", "triangles", "bvh ms/frame",
+                "grid ms/frame", "diff");
+  std::cout << header << std::endl;
+  for (int rings : {16, 64, 256}) {
+    std::istringstream sphere(sphereOBJ(rings));
+    benchmarkDeformation("sphere" + std::to_string(rings), sphere);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,25 @@
+#ifndef _BENCHMARK_H_
+#define _BENCHMARK_H_
+
+#include <string>
+#include <vector>
+
+#define BENCH_RAYS 64            // Rays per side of the square of rays cast at each mesh
+#define BENCH_BRUTE_LIMIT 50000  // Meshes with more triangles skip the brute-force reference
+#define BENCH_FRAMES 8           // Frames of the deforming meshes, each moving every vertex
+#define BENCH_WOBBLE 0.1         // Largest share of its distance from the centre a vertex is pushed out by
+
+/**
+ * @brief Compares the ray accelerators on a set of meshes.
+ * Every OBJ file given, followed by generated spheres of growing size, is
+ * intersected with the same rays through each Accelerator. Build times,
+ * ray throughput and any disagreement with the brute-force reference are
+ * printed as a table. A second table deforms the spheres every frame and
+ * times moving the vertices, updating the BVH or the grid and re-tracing
+ * the rays, with any disagreement between the two.
+ * @param paths The OBJ files to load.
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if a file cannot be opened.
+ */
+int runBenchmark(const std::vector<std::string> &paths);
+
+#endif //_BENCHMARK_H_
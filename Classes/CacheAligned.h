@@ -0,0 +1,56 @@
+#ifndef _CACHE_ALIGNED_H_
+#define _CACHE_ALIGNED_H_
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#define CACHE_LINE 64  // Bytes per cache line
+
+/**
+ * @brief Allocator placing every buffer at the start of a cache line.
+ * Buffers written by several threads use it together with padded strides,
+ * so that no two threads ever write to the same cache line.
+ */
+template <typename T>
+struct CacheAlignedAllocator {
+  typedef T value_type;
+
+  CacheAlignedAllocator() = default;
+  template <typename U>
+  CacheAlignedAllocator(const CacheAlignedAllocator<U> &) {}
+
+  T *allocate(std::size_t n) {
+    void *p = nullptr;
+    if (posix_memalign(&p, CACHE_LINE, n * sizeof(T)) != 0) {
+      throw std::bad_alloc();
+    }
+    return static_cast<T *>(p);
+  }
+
+  void deallocate(T *p, std::size_t) {
+    free(p);
+  }
+
+  template <typename U>
+  bool operator==(const CacheAlignedAllocator<U> &) const { return true; }
+  template <typename U>
+  bool operator!=(const CacheAlignedAllocator<U> &) const { return false; }
+};
+
+template <typename T>
+using CacheAlignedVector = std::vector<T, CacheAlignedAllocator<T>>;
+
+/**
+ * @brief Rounds a row length up to a whole number of cache lines.
+ * @param count The number of elements in a row.
+ * @return The padded number of elements.
+ */
+template <typename T>
+inline int cacheStride(int count) {
+  const int perLine = CACHE_LINE / sizeof(T);
+  return (count + perLine - 1) / perLine * perLine;
+}
+
+#endif //_CACHE_ALIGNED_H_
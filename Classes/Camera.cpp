@@ -1,12 +1,45 @@
+#include <algorithm>
+#include <cmath>
+#include <csignal>
 #include <iostream>
+#include <sys/ioctl.h>
+#include <unistd.h>
 #include "Camera.h"
+#include "GlyphRamp.h"
+
+// Set by SIGWINCH, cleared by the next frame once it has looked at the terminal size
+static volatile std::sig_atomic_t terminalResized = 0;
+
+// Notes that the terminal changed size; the frames pick the new size up
+static void onTerminalResize(int) {
+  terminalResized = 1;
+}
 
 // Constructor that initializes the Camera with a model and a specified origin.
 Camera::Camera(const Model &model, Eigen::Vector3d origin)
-    : _model(model), _canvas(getResolution())
+    : _model(model), _canvas(getResolution()), _pool(ThreadPool::shared())
+{
+  resizeSamples();
+  setOrigin(origin);
+}
+
+// Constructor that draws onto a given canvas, without a terminal.
+Camera::Camera(const Model &model, Eigen::Vector3d origin, const Canvas &canvas, ThreadPool &pool)
+    : _model(model), _canvas(canvas), _pool(pool)
 {
+  resizeSamples();
+  setOrigin(origin);
+}
+
+// Default constructor that initializes the Camera with a predefined origin.
+Camera::Camera(const Model &model)
+    : Camera(model, Eigen::Vector3d(CAMERA_ORIGIN))
+{}
+
+// Moves the camera, keeping it aimed at the world origin.
+void Camera::setOrigin(const Eigen::Vector3d &origin) {
   // Set the camera's origin and light source based on the specified origin.
-  _origin = Eigen::Vector3d(std::move(origin));
+  _origin = origin;
   _lightSource = Eigen::Vector3d(_origin[1], -_origin[0], _origin[2]);
   Eigen::Vector3d normal = _origin.normalized();
 
@@ -15,12 +48,87 @@ Camera::Camera(const Model &model, Eigen::Vector3d origin)
   Eigen::Vector3d up(0, 0, 1);
   _cVec1 = (up - up.dot(normal) * normal).normalized();  // First direction vector
   _cVec2 = (normal.cross(_cVec1)).normalized();          // Second direction vector
+  _raysDirty = true;
 }
 
-// Default constructor that initializes the Camera with a predefined origin.
-Camera::Camera(const Model &model)
-    : Camera(model, Eigen::Vector3d(CAMERA_ORIGIN))
-{}
+// Sizes the sample grid and the shading buffer after the canvas.
+void Camera::resizeSamples() {
+  _sampleRows = std::max(0, static_cast<int>(_canvas.rows())) * _packer.subRows();
+  _sampleCols = std::max(0, static_cast<int>(_canvas.cols())) * _packer.subCols();
+  _traceRows = (_sampleRows + _scale - 1) / _scale;
+  _traceCols = (_sampleCols + _scale - 1) / _scale;
+
+  _samples.resize(_sampleRows, _sampleCols);
+  size_t tiles = static_cast<size_t>((_traceRows + TILE_ROWS - 1) / TILE_ROWS) *
+                 ((_traceCols + TILE_COLS - 1) / TILE_COLS);
+  _tileDarkest.resize(tiles);
+  _tileBrightest.resize(tiles);
+  _raysDirty = true;
+}
+
+// Rebuilds the cached ray directions if the camera basis or canvas size changed.
+void Camera::updateRays() {
+  int rows = _traceRows;
+  int cols = _traceCols;
+  if (!_raysDirty && static_cast<int>(_ndcY.size()) == rows && static_cast<int>(_ndcX.size()) == cols) {
+    return;
+  }
+  _raysDirty = false;
+
+  // The samples of a cell are spread evenly around the point a single sample would take,
+  // and a traced sample sits in the middle of the block of samples it stands for
+  const int subRows = _packer.subRows(), subCols = _packer.subCols();
+  _ndcY.resize(rows);
+  _ndcX.resize(cols);
+  for (int i = 0; i < rows; i++) {
+    _ndcY[i] = _canvas.getNDCy((i + 0.5f) * _scale / subRows - 0.5f);  // Normalized Device Coordinate Y
+  }
+  for (int j = 0; j < cols; j++) {
+    _ndcX[j] = _canvas.getNDCx((j + 0.5f) * _scale / subCols - 0.5f);  // Normalized Device Coordinate X
+  }
+
+  _cellDirs.resize(static_cast<size_t>(rows) * cols);
+  _cellUnits.resize(_cellDirs.size());
+  for (int i = 0; i < rows; i++) {
+    for (int j = 0; j < cols; j++) {
+      Eigen::Vector3d dir = (_cPoint0 + _ndcY[i] * _cVec1 + _ndcX[j] * _cVec2) - _origin;
+      _cellDirs[static_cast<size_t>(i) * cols + j] = dir;
+      _cellUnits[static_cast<size_t>(i) * cols + j] = dir.normalized();
+    }
+  }
+  _objRows.resize(rows);
+}
+
+// Queries the size of the terminal on standard output.
+bool Camera::terminalSize(int &rows, int &cols) {
+  struct winsize w;
+  if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &w) == -1) {
+    return false;
+  }
+  rows = w.ws_row;
+  cols = w.ws_col;
+  return true;
+}
+
+// Starts following the terminal size from frame to frame.
+void Camera::watchResize() {
+  struct sigaction action = {};
+  action.sa_handler = onTerminalResize;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESTART;  // Writing a frame is not interrupted by a resize
+  if (sigaction(SIGWINCH, &action, nullptr) == -1) {
+    std::cerr << "Failed to watch the terminal size." << std::endl;
+  }
+}
+
+// Checks whether the terminal was resized since the last check.
+bool Camera::resizePending() {
+  if (!terminalResized) {
+    return false;
+  }
+  terminalResized = 0;
+  return true;
+}
 
 // Gets the resolution of the canvas based on the terminal size or debug settings.
 Canvas Camera::getResolution() {
@@ -30,80 +138,341 @@ Canvas Camera::getResolution() {
   return DEBUG_CANVAS;
 #else
   // Get terminal size for non-debug mode
-    struct winsize w;
-    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &w) == -1) {
+    int rows, cols;
+    if (!terminalSize(rows, cols)) {
         std::cerr << "Failed to get terminal size." << std::endl;
         return {-1, -1};  // Return invalid size if there's an error
     }
-    std::cout << "Rows: " << w.ws_row << std::endl;
-    std::cout << "Cols: " << w.ws_col << std::endl;
-    return {w.ws_row, w.ws_col};  // Return terminal size
+    std::cout << "Rows: " << rows << std::endl;
+    std::cout << "Cols: " << cols << std::endl;
+    return {rows, cols};  // Return terminal size
 #endif
 }
 
 // Performs ray tracing to render the model onto the canvas.
 void Camera::rayTrace() {
-  for (int i = 0; i < _canvas.rows(); i++) {
-    for (int j = 0; j < _canvas.cols(); j++) {
-      float s1 = _canvas.getNDCy(i);  // Normalized Device Coordinate Y
-      float s2 = _canvas.getNDCx(j);  // Normalized Device Coordinate X
+  // The terminal may have been resized since the last frame
+  if (resizePending()) {
+#ifndef DEBUG
+    int rows, cols;
+    if (terminalSize(rows, cols) && (rows != static_cast<int>(_canvas.rows()) ||
+                                     cols != static_cast<int>(_canvas.cols()))) {
+      resize(rows, cols);
+    }
+#endif
+  }
+
+  _pool.parallelFor(beginFrame(), [&](unsigned int tile, unsigned int) { renderTile(tile); });
+  finishFrame();
+}
+
+// Prepares a frame to be traced tile by tile.
+unsigned int Camera::beginFrame() {
+  // Bring the camera into object space once per frame instead of moving the model
+  Eigen::Affine3d toObject = _model.worldToObject();
+  _normalToWorld = _model.normalToWorld();
+  _objOrigin = toObject * _origin;
+  _objPoint0 = toObject * _cPoint0;
+  _objVec1 = toObject.linear() * _cVec1;
+  _objVec2 = toObject.linear() * _cVec2;
+  _objLight = toObject * _lightSource;
 
-      // Calculate the direction of the ray
-      Eigen::Vector3d dir = (_cPoint0 + s1 * _cVec1 + s2 * _cVec2) - _origin;
+  // Every cell's object-space ray is its row's direction stepped along _objVec2
+  updateRays();
+  for (size_t i = 0; i < _objRows.size(); i++) {
+    _objRows[i] = (_objPoint0 - _objOrigin) + _ndcY[i] * _objVec1;
+  }
+
+  if (_mode == RenderMode::Raster) {
+    _rasterizer.setup(_model.mesh(), _canvas, _packer.subRows(), _packer.subCols(), _scale, _objOrigin, _objPoint0,
+                      _objVec1, _objVec2, _pool);
+  }
+
+  int tilesX = (_traceCols + TILE_COLS - 1) / TILE_COLS;
+  int tilesY = (_traceRows + TILE_ROWS - 1) / TILE_ROWS;
+  return static_cast<unsigned int>(std::max(0, tilesX * tilesY));
+}
+
+// Traces one tile of the frame begun last.
+void Camera::renderTile(unsigned int tile) {
+  int tilesX = (_traceCols + TILE_COLS - 1) / TILE_COLS;
+  int row0 = tile / tilesX * TILE_ROWS;
+  int col0 = tile % tilesX * TILE_COLS;
+  ShadowBatch shadows;
+  switch (_mode) {
+    case RenderMode::RayCast:
+      traceTile(row0, col0, shadows);
+      break;
+    case RenderMode::Packet:
+      tracePackets(row0, col0, shadows);
+      break;
+    case RenderMode::Raster:
+      rasterTile(row0, col0, shadows);
+      break;
+  }
+  castShadows(shadows);
+  tileRange(tile, row0, col0);
+}
 
-      Eigen::Vector3d normal;
-      Eigen::Vector3d P;
+// Records the darkest and the brightest sample of a tile just traced.
+void Camera::tileRange(unsigned int tile, int row0, int col0) {
+  int rowEnd = std::min(row0 + TILE_ROWS, _traceRows);
+  int colEnd = std::min(col0 + TILE_COLS, _traceCols);
+  float darkest = INFINITY, brightest = -INFINITY;
+  for (int i = row0; i < rowEnd; i++) {
+    const float *shades = _samples.brightness() + static_cast<size_t>(i) * _samples.stride();
+    for (int j = col0; j < colEnd; j++) {
+      if (shades[j] == -INFINITY)
+        continue;
+      darkest = std::min(darkest, shades[j]);
+      brightest = std::max(brightest, shades[j]);
+    }
+  }
+  _tileDarkest[tile] = darkest;
+  _tileBrightest[tile] = brightest;
+}
+
+// Upscales the traced samples and draws them onto the canvas, outlines included.
+void Camera::finishFrame() {
+  _darkest = INFINITY;
+  _brightest = -INFINITY;
+  for (size_t t = 0; t < _tileDarkest.size(); t++) {
+    _darkest = std::min(_darkest, _tileDarkest[t]);
+    _brightest = std::max(_brightest, _tileBrightest[t]);
+  }
+  _samples.upscale(_scale);
+  draw();  // Render the strokes onto the canvas
+  if (_outlines) {
+    _edges.outline(_samples, _packer.subRows(), _packer.subCols(), _canvas);
+  }
+}
+
+// Traces every sample of one tile into the shading buffer.
+void Camera::traceTile(int row0, int col0, ShadowBatch &shadows) {
+  int rowEnd = std::min(row0 + TILE_ROWS, _traceRows);
+  int colEnd = std::min(col0 + TILE_COLS, _traceCols);
+
+  for (int i = row0; i < rowEnd; i++) {
+    for (int j = col0; j < colEnd; j++) {
+      Hit hit;
       // Check for intersection with the model
-      if (_model.intersect(_origin, dir, normal, P)) {
-        Eigen::Vector3d ince = -dir.normalized();  // Incoming direction
-        Eigen::Vector3d refr = (_lightSource - P).normalized();  // Light direction
-        Eigen::Vector3d inter = ince / 2 + refr / 2;  // Average vector for shading
-        _strokes.emplace_back(normal.dot(inter), i, j);  // Store stroke data
+      if (_model.intersectObject(_objOrigin, objectDirection(i, j), hit)) {
+        shadeSample(i, j, hit, shadows);  // Store stroke data
       } else {
-        _strokes.emplace_back(-INFINITY, i, j);  // No intersection
+        _samples.miss(i, j);  // No intersection
       }
     }
   }
-  draw();  // Render the strokes onto the canvas
 }
 
-// Prints the current state of the canvas for debugging.
-void Camera::print() {
-  std::cout << _canvas << std::endl;
+// Traces one tile as packets of neighbouring samples.
+void Camera::tracePackets(int row0, int col0, ShadowBatch &shadows) {
+  int rowEnd = std::min(row0 + TILE_ROWS, _traceRows);
+  int colEnd = std::min(col0 + TILE_COLS, _traceCols);
+  RayPacket packet;
+  Hit hits[PACKET_RAYS];
+
+  for (int pi = row0; pi < rowEnd; pi += PACKET_SIZE) {
+    for (int pj = col0; pj < colEnd; pj += PACKET_SIZE) {
+      // Samples past the edge of the canvas stay out of the packet
+      packet.reset(_objOrigin);
+      for (int r = 0; r < PACKET_RAYS; r++) {
+        int i = pi + r / PACKET_SIZE, j = pj + r % PACKET_SIZE;
+        if (i < rowEnd && j < colEnd) {
+          packet.setRay(r, objectDirection(i, j));
+        }
+      }
+
+      uint64_t hit = _model.intersectPacket(packet, hits);
+      for (int r = 0; r < PACKET_RAYS; r++) {
+        int i = pi + r / PACKET_SIZE, j = pj + r % PACKET_SIZE;
+        if (!(packet.active >> r & 1)) {
+          continue;
+        }
+        if (hit >> r & 1) {
+          shadeSample(i, j, hits[r], shadows);
+        } else {
+          _samples.miss(i, j);
+        }
+      }
+    }
+  }
 }
 
-// Draws the strokes onto the canvas based on brightness levels.
-void Camera::draw() {
-  auto minMax = std::minmax_element(_strokes.begin(), _strokes.end(),
-                                    [](const auto& a, const auto& b) { return std::get<0>(a) < std::get<0>(b); });
+// Rasterizes one tile and shades its samples.
+void Camera::rasterTile(int row0, int col0, ShadowBatch &shadows) {
+  int rowEnd = std::min(row0 + TILE_ROWS, _traceRows);
+  int colEnd = std::min(col0 + TILE_COLS, _traceCols);
+  _rasterizer.rasterTile(row0, col0);
+
+  for (int i = row0; i < rowEnd; i++) {
+    for (int j = col0; j < colEnd; j++) {
+      const Hit &hit = _rasterizer.hit(i, j);
+      if (hit.t < INFINITY) {
+        shadeSample(i, j, hit, shadows);
+      } else {
+        _samples.miss(i, j);
+      }
+    }
+  }
+}
+
+// Computes the brightness of a sample from the surface its ray hit.
+double Camera::shade(int i, int j, const Hit &hit, double &light, Eigen::Vector3d &normal) const {
+  const size_t cell = static_cast<size_t>(i) * _ndcX.size() + j;
+  Eigen::Vector3d P = _origin + hit.t * _cellDirs[cell];  // Hit point in world space
+  normal = _normalToWorld * _model.hitNormal(hit);
+  Eigen::Vector3d ince = -_cellUnits[cell];  // Incoming direction
+  Eigen::Vector3d refr = (_lightSource - P).normalized();  // Light direction
+  Eigen::Vector3d inter = ince / 2 + refr / 2;  // Average vector for shading
+  light = normal.dot(refr / 2);
+  return normal.dot(inter);
+}
+
+// Shades a sample that hit the model, queueing it for a shadow ray if its surface faces the light.
+void Camera::shadeSample(int i, int j, const Hit &hit, ShadowBatch &shadows) {
+  double light;
+  Eigen::Vector3d normal;
+  double brightness = shade(i, j, hit, light, normal);
+  _samples.set(i, j, brightness, hit.t, hit.face, normal);
+  if (_shadows && light > 0) {
+    // A surface facing away from the light is dark already; only light that arrives can be blocked
+    int k = shadows.count++;
+    shadows.row[k] = i;
+    shadows.col[k] = j;
+    shadows.depth[k] = static_cast<float>(hit.t);
+    shadows.light[k] = static_cast<float>(light);
+  }
+}
+
+// Traces the shadow rays of a tile and darkens the samples the light cannot reach.
+void Camera::castShadows(const ShadowBatch &shadows) {
+  RayPacket packet;
+  for (int first = 0; first < shadows.count; first += PACKET_RAYS) {
+    // Samples were queued in tracing order, so a packet holds neighbours whose rays stay close
+    int count = std::min(PACKET_RAYS, shadows.count - first);
+    packet.reset(_objLight);
+    for (int r = 0; r < count; r++) {
+      int k = first + r;
+      Eigen::Vector3d P = _objOrigin + shadows.depth[k] * objectDirection(shadows.row[k], shadows.col[k]);
+      packet.setRay(r, P - _objLight, static_cast<float>(1 - SHADOW_BIAS));
+    }
+    for (uint64_t blocked = _model.occludedPacket(packet); blocked != 0; blocked &= blocked - 1) {
+      int k = first + __builtin_ctzll(blocked);
+      _samples.darken(shadows.row[k], shadows.col[k], shadows.light[k]);
+    }
+  }
+}
+
+// Selects how primary visibility is computed.
+void Camera::setRenderMode(RenderMode mode) {
+  _mode = mode;
+}
+
+// Turns hard shadows on or off.
+void Camera::setShadows(bool enabled) {
+  _shadows = enabled;
+}
+
+// Turns outlines on or off.
+void Camera::setOutlines(bool enabled) {
+  _outlines = enabled;
+}
+
+// Selects how many samples are traced per cell and how they are drawn.
+void Camera::setGlyphMode(GlyphMode mode) {
+  _glyphMode = mode;
+  _packer = GlyphPacker(mode);
+  _canvas.reshape(static_cast<int>(_canvas.rows()), static_cast<int>(_canvas.cols()),
+                  mode == GlyphMode::Ascii ? 1 : CELL_UTF8, _canvas.colorMode());
+  resizeSamples();
+}
+
+// Selects whether and how the shading is also drawn in colour.
+void Camera::setColorMode(ColorMode mode) {
+  _canvas.reshape(static_cast<int>(_canvas.rows()), static_cast<int>(_canvas.cols()), _canvas.cellBytes(), mode);
+}
+
+// Traces fewer rays and upscales them into the canvas.
+void Camera::setRenderScale(int scale) {
+  _scale = std::max(1, scale);
+  resizeSamples();
+}
+
+// Changes the number of cells drawn.
+void Camera::resize(int rows, int cols) {
+  _canvas.reshape(rows, cols, _canvas.cellBytes(), _canvas.colorMode());
+  resizeSamples();
+}
+
+// Retrieves the canvas of the last frame drawn.
+const Canvas &Camera::canvas() const {
+  return _canvas;
+}
 
-  double brightest = -INFINITY;
-  double darkest = INFINITY;
+// Retrieves the canvas of the last frame drawn, to hand it over without copying.
+Canvas &Camera::canvas() {
+  return _canvas;
+}
+
+// Writes the shading of the last frame as a binary PGM or PPM image.
+void Camera::drawImage(std::string &image, bool color) const {
+  const float range = _brightest - _darkest;
+
+  image.clear();
+  image += color ? "P6\n" : "P5\n";
+  image += std::to_string(_sampleCols) + " " + std::to_string(_sampleRows) + "\n255\n";
+  for (int i = 0; i < _sampleRows; i++) {
+    const float *shades = _samples.brightness() + static_cast<size_t>(i) * _samples.stride();
+    for (int j = 0; j < _sampleCols; j++) {
+      float shine = shades[j];
+      double level = range > 0 ? (shine - _darkest) / range : 1;  // A flat frame is as bright as it gets
+      if (!color) {
+        image.push_back(shine == -INFINITY ? 0 : static_cast<char>(std::lround(level * 255)));
+        continue;
+      }
+      uint32_t rgb = shine == -INFINITY ? 0 : _packer.shadeColor(level);
+      image.push_back(static_cast<char>(rgb >> 16));
+      image.push_back(static_cast<char>(rgb >> 8));
+      image.push_back(static_cast<char>(rgb));
+    }
+  }
+}
 
-  // Determine the brightest and darkest strokes
-  for (const auto& stroke : _strokes) {
-    double shine = std::get<0>(stroke);
-    if (shine == INFINITY || shine == -INFINITY)
-      continue;
-    if (shine < darkest)
-      darkest = shine;
-    if (shine > brightest)
-      brightest = shine;
+// Draws the strokes onto the canvas based on brightness levels.
+void Camera::draw() {
+  // The range was gathered while tracing, so normalizing and drawing take a single pass
+  const float range = _brightest - _darkest;  // Range of brightness
+  if (_glyphMode != GlyphMode::Ascii) {
+    _packer.pack(_samples.brightness(), _samples.stride(), _darkest, range, _canvas);
+    return;
   }
 
-  double range = brightest - darkest;  // Range of brightness
-  std::string brush = "$@B%8&WM#*oahkbdpqwmZO0QLCJUYXzcvunxrjft/\\|()"
-                      "1{}[]?-_+~<>i!lI;:,^`'.";  // Characters for rendering
+  int rows = _sampleRows;
+  int cols = _sampleCols;
+  const bool colored = _canvas.colors() != nullptr;
+  const GlyphRamp &ramp = GlyphRamp::shared();
+  // Brightness to level in one multiply-add; a flat frame draws with the densest glyph
+  const float toLevel = range > 0 ? (GLYPH_RAMP_LEVELS - 1) / range : 0;
+  const float round = range > 0 ? 0.5f : GLYPH_RAMP_LEVELS - 0.5f;
 
   // Draw the strokes onto the canvas
-  for (const auto& stroke : _strokes) {
-    double shine = std::get<0>(stroke);
-    if (shine == -INFINITY) {
-      _canvas.draw(' ', std::get<1>(stroke), std::get<2>(stroke));  // Empty space for no intersection
-    } else {
-      double inter = (brightest - shine) / range;  // Normalize shine
-      int brushIndex = inter * brush.size();  // Map to brush index
-      _canvas.draw(brush[brushIndex], std::get<1>(stroke), std::get<2>(stroke));  // Draw character
+  for (int i = 0; i < rows; i++) {
+    const float *shades = _samples.brightness() + static_cast<size_t>(i) * _samples.stride();
+    for (int j = 0; j < cols; j++) {
+      float shine = shades[j];
+      if (shine == -INFINITY) {
+        _canvas.draw(' ', i, j);  // Empty space for no intersection
+        if (colored) {
+          _canvas.setColor(i, j, COLOR_DEFAULT, COLOR_DEFAULT);
+        }
+      } else {
+        int level = static_cast<int>((shine - _darkest) * toLevel + round);  // Never past the last level
+        _canvas.draw(ramp.glyph(level), i, j);  // Draw character
+        if (colored) {
+          _canvas.setColor(i, j, _packer.shadeColor(level / (GLYPH_RAMP_LEVELS - 1.0)), COLOR_DEFAULT);  // Shade the character too
+        }
+      }
     }
   }
 }
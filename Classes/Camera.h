@@ -3,10 +3,28 @@
 
 #include "Model.h"
 #include "Canvas.h"
+#include "CacheAligned.h"
+#include "ThreadPool.h"
+#include "Rasterizer.h"
+#include "GlyphPacker.h"
+#include "ShadingBuffer.h"
+#include "EdgeDetector.h"
 
 // Define constants for debugging and camera origin
 #define DEBUG_CANVAS {22, 150}  // Dimensions for the debug canvas
 #define CAMERA_ORIGIN 4, 4, 4    // Default camera origin coordinates
+#define TILE_ROWS 8              // Rows of samples traced as one task
+#define TILE_COLS 32             // Columns of samples traced as one task, a multiple of a cache line
+#define SHADOW_BIAS 1e-3         // Share of a shadow ray left out at the surface end, so no surface shadows itself
+
+/**
+ * @brief How Camera::rayTrace finds the surface seen by each cell.
+ */
+enum class RenderMode {
+  RayCast,  ///< One ray per cell
+  Packet,   ///< PACKET_SIZE x PACKET_SIZE cells traced together as a packet
+  Raster    ///< Triangles projected onto the canvas and resolved with a z-buffer
+};
 
 /**
  * @class Camera
@@ -18,14 +36,147 @@
  */
 class Camera {
  private:
+  /**
+   * @brief Samples of one tile whose surface faces the light, waiting for their shadow rays.
+   * Filled in while the tile is traced and emptied right after, so the
+   * shadow rays of neighbouring samples are traced together.
+   */
+  struct ShadowBatch {
+    int count = 0;                          ///< Samples queued
+    int row[TILE_ROWS * TILE_COLS];         ///< Sample row of each
+    int col[TILE_ROWS * TILE_COLS];         ///< Sample column of each
+    float depth[TILE_ROWS * TILE_COLS];     ///< Ray parameter of each sample's hit
+    float light[TILE_ROWS * TILE_COLS];     ///< Brightness the light adds to each sample
+  };
+
   const Model& _model;              ///< Reference to the model being rendered
   Eigen::Vector3d _origin;          ///< The camera's position in 3D space
   Eigen::Vector3d _cPoint0;         ///< First control point for camera manipulation
   Eigen::Vector3d _cVec1;           ///< First direction vector for camera orientation
   Eigen::Vector3d _cVec2;           ///< Second direction vector for camera orientation
   Eigen::Vector3d _lightSource;     ///< Position of the light source
-  std::vector<std::tuple<double, int, int>> _strokes; ///< Stores stroke data for rendering
   Canvas _canvas;                   ///< The canvas where the model will be drawn
+  ShadingBuffer _samples;           ///< Brightness, depth and face of every sample
+  std::vector<float> _tileDarkest;  ///< Lowest brightness hit in every tile, gathered as the tile is traced
+  std::vector<float> _tileBrightest; ///< Highest brightness hit in every tile
+  float _darkest = INFINITY;        ///< Lowest brightness hit in the last frame
+  float _brightest = -INFINITY;     ///< Highest brightness hit in the last frame
+  GlyphMode _glyphMode = GlyphMode::Ascii; ///< How the samples of a cell become a character
+  GlyphPacker _packer{GlyphMode::Ascii};   ///< Turns sub-cell samples into glyphs
+  int _sampleRows;                  ///< Rows of samples drawn, _packer.subRows() per cell
+  int _sampleCols;                  ///< Columns of samples drawn, _packer.subCols() per cell
+  int _scale = 1;                   ///< Samples along each axis sharing one traced ray
+  int _traceRows;                   ///< Rows of samples traced, one per _scale sample rows
+  int _traceCols;                   ///< Columns of samples traced, one per _scale sample columns
+  ThreadPool &_pool;                ///< Threads tracing the tiles
+  RenderMode _mode = RenderMode::Packet; ///< How primary visibility is computed
+  bool _shadows = false;            ///< Whether samples the light cannot reach lose its share of brightness
+  bool _outlines = false;           ///< Whether silhouettes and creases are outlined after drawing
+  EdgeDetector _edges;              ///< Finds the outlines in the depth and normals of the samples
+  Rasterizer _rasterizer{TILE_ROWS, TILE_COLS}; ///< Z-buffer used by RenderMode::Raster
+
+  // Camera in the model's object space, refreshed at the start of every frame
+  Eigen::Vector3d _objOrigin;       ///< Camera position in object space
+  Eigen::Vector3d _objPoint0;       ///< _cPoint0 in object space
+  Eigen::Vector3d _objVec1;         ///< _cVec1 in object space
+  Eigen::Vector3d _objVec2;         ///< _cVec2 in object space
+  Eigen::Vector3d _objLight;        ///< _lightSource in object space
+  Eigen::Matrix3d _normalToWorld;   ///< Maps the model's normals back to world space
+  std::vector<Eigen::Vector3d> _objRows; ///< Object-space ray direction of every traced row at NDC x = 0
+
+  // Ray generation, rebuilt only when the camera basis, the canvas size or the render scale changes
+  std::vector<float> _ndcX;               ///< NDC x of every traced column
+  std::vector<float> _ndcY;               ///< NDC y of every traced row
+  std::vector<Eigen::Vector3d> _cellDirs;  ///< World-space ray direction of every traced sample, row by row
+  std::vector<Eigen::Vector3d> _cellUnits; ///< The same directions, normalized
+  bool _raysDirty = true;                 ///< Set when the camera basis changes
+
+  /**
+   * @brief Sizes the sample grid and the shading buffer after the canvas.
+   * Every buffer keeps its capacity, so a terminal shrinking and growing
+   * back never reallocates.
+   */
+  void resizeSamples();
+
+  /**
+   * @brief Rebuilds the cached ray directions if the camera basis or canvas size changed.
+   */
+  void updateRays();
+
+  /**
+   * @brief Traces every sample of one tile into the shading buffer.
+   * Tiles cover disjoint samples, so any number of them can be traced at once.
+   * Tiles and the sample indices below count traced samples.
+   * @param row0 The first sample row of the tile.
+   * @param col0 The first sample column of the tile.
+   * @param shadows Receives the samples needing a shadow ray.
+   */
+  void traceTile(int row0, int col0, ShadowBatch &shadows);
+
+  /**
+   * @brief Traces one tile as packets of neighbouring samples.
+   * @param row0 The first sample row of the tile.
+   * @param col0 The first sample column of the tile.
+   * @param shadows Receives the samples needing a shadow ray.
+   */
+  void tracePackets(int row0, int col0, ShadowBatch &shadows);
+
+  /**
+   * @brief Rasterizes one tile and shades its samples.
+   * The triangles must already be set up for the frame.
+   * @param row0 The first sample row of the tile.
+   * @param col0 The first sample column of the tile.
+   * @param shadows Receives the samples needing a shadow ray.
+   */
+  void rasterTile(int row0, int col0, ShadowBatch &shadows);
+
+  /**
+   * @brief Computes the object-space ray direction of a sample for the current frame.
+   * @param i The sample row.
+   * @param j The sample column.
+   * @return The direction, not normalized.
+   */
+  Eigen::Vector3d objectDirection(int i, int j) const {
+    return _objRows[i] + _ndcX[j] * _objVec2;
+  }
+
+  /**
+   * @brief Computes the brightness of a sample from the surface its ray hit.
+   * @param i The sample row.
+   * @param j The sample column.
+   * @param hit The hit of the sample's ray, in object space.
+   * @param light Receives the part of the brightness that comes from the light.
+   * @param normal Receives the world-space normal of the surface at the hit.
+   * @return The brightness of the sample.
+   */
+  double shade(int i, int j, const Hit &hit, double &light, Eigen::Vector3d &normal) const;
+
+  /**
+   * @brief Shades a sample that hit the model, queueing it for a shadow ray if its surface faces the light.
+   * @param i The sample row.
+   * @param j The sample column.
+   * @param hit The hit of the sample's ray, in object space.
+   * @param shadows Receives the sample if it needs a shadow ray.
+   */
+  void shadeSample(int i, int j, const Hit &hit, ShadowBatch &shadows);
+
+  /**
+   * @brief Traces the shadow rays of a tile and darkens the samples the light cannot reach.
+   * Every shadow ray runs from the light to its sample, so they all share
+   * the light as origin and go through the model as packets, each ray
+   * stopping at the first occluder it finds.
+   * @param shadows The samples of the tile facing the light.
+   */
+  void castShadows(const ShadowBatch &shadows);
+
+  /**
+   * @brief Records the darkest and the brightest sample of a tile just traced.
+   * The tile is still in cache, so the frame's range costs no pass of its own.
+   * @param tile The tile.
+   * @param row0 The first sample row of the tile.
+   * @param col0 The first sample column of the tile.
+   */
+  void tileRange(unsigned int tile, int row0, int col0);
 
  public:
   /**
@@ -41,35 +192,153 @@ class Camera {
    */
   Camera(const Model& model, Eigen::Vector3d origin);
 
+  /**
+   * @brief Constructs a Camera drawing onto a canvas of its own size, without a terminal.
+   * @param model The model to be rendered by the camera.
+   * @param origin The initial position of the camera.
+   * @param canvas The canvas to draw onto, whose size and aspect ratio are kept.
+   * @param pool The threads tracing the tiles; a pool of one traces them on the calling thread.
+   */
+  Camera(const Model& model, Eigen::Vector3d origin, const Canvas &canvas, ThreadPool &pool);
+
   /**
    * @brief Retrieves the resolution of the canvas.
    * @return The current resolution of the canvas.
    */
   Canvas getResolution();
 
+  /**
+   * @brief Starts following the terminal size from frame to frame.
+   *
+   * Installs a SIGWINCH handler that only raises a flag; the next call to
+   * rayTrace() looks at the new size and resizes the canvas to it.
+   */
+  static void watchResize();
+
+  /**
+   * @brief Checks whether the terminal was resized since the last check.
+   * @return True once for every resize noticed by the handler watchResize() installs.
+   */
+  static bool resizePending();
+
+  /**
+   * @brief Queries the size of the terminal on standard output.
+   * @param rows Receives the number of rows.
+   * @param cols Receives the number of columns.
+   * @return True if the size is known.
+   */
+  static bool terminalSize(int &rows, int &cols);
+
   /**
    * @brief Performs ray tracing to render the model.
    *
    * This function calculates the rays from the camera's position
    * through each pixel on the canvas to determine the color and
    * brightness of each pixel based on the model's geometry and light source.
+   * The canvas is split into tiles that the thread pool traces in parallel.
+   * A resize of the terminal noticed since the last frame is applied first.
    */
   void rayTrace();
 
   /**
-   * @brief Prints the current state of the camera.
-   *
-   * This function outputs relevant information about the camera's
-   * position and configuration to the console for debugging purposes.
+   * @brief Prepares a frame to be traced tile by tile, as rayTrace() does on its own pool.
+   * Tiles of several cameras can then share one parallelFor() of a pool;
+   * the frame ends with finishFrame() once every tile is done.
+   * @return The number of tiles in the frame.
+   */
+  unsigned int beginFrame();
+
+  /**
+   * @brief Traces one tile of the frame begun last.
+   * Tiles are independent, so any number of them can be traced at once.
+   * @param tile The tile, below the count beginFrame() returned.
+   */
+  void renderTile(unsigned int tile);
+
+  /**
+   * @brief Upscales the traced samples and draws them onto the canvas, outlines included.
+   */
+  void finishFrame();
+
+  /**
+   * @brief Changes the number of cells drawn.
+   * @param rows The number of rows of the canvas.
+   * @param cols The number of columns of the canvas.
+   */
+  void resize(int rows, int cols);
+
+  /**
+   * @brief Moves the camera, keeping it aimed at the world origin.
+   * @param origin The new position of the camera.
+   */
+  void setOrigin(const Eigen::Vector3d &origin);
+
+  /**
+   * @brief Selects how primary visibility is computed.
+   * @param mode The render mode to use from the next frame on.
+   */
+  void setRenderMode(RenderMode mode);
+
+  /**
+   * @brief Turns hard shadows on or off.
+   * With shadows, every sample facing the light traces one more ray toward
+   * it, and loses the light's share of its brightness if the model is in the way.
+   * @param enabled True to cast shadows from the next frame on.
+   */
+  void setShadows(bool enabled);
+
+  /**
+   * @brief Turns outlines on or off.
+   * With outlines, cells on a silhouette or a crease of the model are drawn
+   * as lines following it, found from the depth and normals already traced.
+   * @param enabled True to outline from the next frame on.
+   */
+  void setOutlines(bool enabled);
+
+  /**
+   * @brief Selects how many samples are traced per cell and how they are drawn.
+   * The sub-cell modes draw UTF-8 glyphs, so the terminal must use UTF-8.
+   * @param mode The glyph mode to use from the next frame on.
    */
-  void print();
+  void setGlyphMode(GlyphMode mode);
 
   /**
-   * @brief Retrieves the stroke character based on brightness.
-   * @param brightness The brightness level to determine the stroke.
-   * @return The character representing the stroke.
+   * @brief Selects whether and how the shading is also drawn in colour.
+   * @param mode The colour mode to use from the next frame on.
    */
-  char getStroke(double brightness);
+  void setColorMode(ColorMode mode);
+
+  /**
+   * @brief Traces fewer rays and upscales them into the canvas.
+   * Every traced sample is drawn as a block of scale x scale samples,
+   * cutting the rays of a frame by scale squared.
+   * @param scale The samples along each axis sharing one ray, 1 for full resolution.
+   */
+  void setRenderScale(int scale);
+
+  /**
+   * @brief Retrieves the canvas of the last frame drawn.
+   * @return The canvas.
+   */
+  const Canvas &canvas() const;
+
+  /**
+   * @brief Retrieves the canvas of the last frame drawn, to hand it over without copying.
+   * The caller may swap it for another canvas of the same layout, as
+   * Presenter::submit() does; every frame is drawn over the whole canvas.
+   * @return The canvas.
+   */
+  Canvas &canvas();
+
+  /**
+   * @brief Writes the shading of the last frame as a binary PGM or PPM image.
+   * Every sample becomes one pixel, brightness normalized as draw() does;
+   * in colour the pixels follow the shading ramp of the colour modes.
+   * Samples that missed the model are black.
+   * @param image Receives the whole image file, header included.
+   * @param color True for a PPM image, false for a greyscale PGM one.
+   */
+  void drawImage(std::string &image, bool color) const;
 
   /**
    * @brief Draws the model onto the canvas.
@@ -78,8 +347,6 @@ class Camera {
    * the ray-traced information into visual strokes.
    */
   void draw();
-
-  // TODO: add a change camera position option
 };
 
 #endif //_CAMERA_H_
@@ -1,13 +1,48 @@
+#include <algorithm>
+#include <cstring>
+#include <ostream>
 #include "Canvas.h"
 
 /**
  * @brief Constructs a Canvas object with specified dimensions.
  * @param rows The number of rows in the canvas.
  * @param cols The number of columns in the canvas.
+ * @param cellBytes The bytes of every cell: 1 for ASCII, CELL_UTF8 for UTF-8 glyphs.
+ * @param colorMode How the colours of the cells reach the terminal, if at all.
  */
-Canvas::Canvas(int rows, int cols) : _rows(rows), _cols(cols) {
+Canvas::Canvas(int rows, int cols, int cellBytes, ColorMode colorMode) {
+  reshape(rows, cols, cellBytes, colorMode);
+}
+
+/**
+ * @brief Changes the dimensions and layout of the canvas and clears it.
+ * @param rows The number of rows in the canvas.
+ * @param cols The number of columns in the canvas.
+ * @param cellBytes The bytes of every cell: 1 for ASCII, CELL_UTF8 for UTF-8 glyphs.
+ * @param colorMode How the colours of the cells reach the terminal, if at all.
+ */
+void Canvas::reshape(int rows, int cols, int cellBytes, ColorMode colorMode) {
+  _rows = rows;
+  _cols = cols;
+  _cellBytes = cellBytes;
+  _colorMode = colorMode;
   _aspectRatio = _cols / (_rows * CHAR_DIM);  // Calculate aspect ratio based on dimensions
-  _strokes.assign(rows * cols, ' ');          // Initialize the canvas with empty spaces
+  _stride = cols > 0 ? cols * cellBytes + 1 : 0;  // Room for the line terminator
+  // Neither buffer gives back its capacity when it shrinks
+  _strokes.resize(rows > 0 ? static_cast<size_t>(rows) * _stride : 0);
+  bool colored = colorMode != ColorMode::None && rows > 0 && cols > 0;
+  _colors.resize(colored ? 2 * static_cast<size_t>(rows) * cols : 0);  // A foreground and a background per cell
+  clear();  // Initialize the canvas with empty spaces
+}
+
+/**
+ * @brief Position of a cell in the stroke buffer.
+ * @param index The index of the cell, counted row by row.
+ * @return The offset of the cell, skipping the line terminators before it.
+ */
+size_t Canvas::offset(size_t index) const {
+  size_t cols = static_cast<size_t>(_cols);
+  return index / cols * _stride + index % cols * _cellBytes;
 }
 
 /**
@@ -28,20 +63,46 @@ float Canvas::cols() const {
 
 /**
  * @brief Converts a canvas x-coordinate to Normalized Device Coordinates (NDC).
- * @param x The x-coordinate on the canvas.
+ * @param x The x-coordinate on the canvas, fractional between cells.
  * @return The NDC x-coordinate.
  */
-float Canvas::getNDCx(int x) {
-  return (2 * (static_cast<float>(x) / _cols) - 1) / _aspectRatio;  // Scale to NDC and account for aspect ratio
+float Canvas::getNDCx(float x) const {
+  return (2 * (x / _cols) - 1) / _aspectRatio;  // Scale to NDC and account for aspect ratio
 }
 
 /**
  * @brief Converts a canvas y-coordinate to Normalized Device Coordinates (NDC).
- * @param y The y-coordinate on the canvas.
+ * @param y The y-coordinate on the canvas, fractional between cells.
  * @return The NDC y-coordinate.
  */
-float Canvas::getNDCy(int y) {
-  return -((2 * (static_cast<float>(y) / _rows) - 1)) / CHAR_DIM;  // Scale to NDC, flipping the y-axis
+float Canvas::getNDCy(float y) const {
+  return -((2 * (y / _rows) - 1)) / CHAR_DIM;  // Scale to NDC, flipping the y-axis
+}
+
+/**
+ * @brief Overrides the aspect ratio derived from the dimensions.
+ * @param aspectRatio The aspect ratio getNDCx() divides by.
+ */
+void Canvas::setAspectRatio(float aspectRatio) {
+  _aspectRatio = aspectRatio;
+}
+
+/**
+ * @brief Converts an NDC x-coordinate back to a canvas x-coordinate.
+ * @param ndc The NDC x-coordinate.
+ * @return The canvas x-coordinate, fractional between cells.
+ */
+float Canvas::getCanvasX(float ndc) const {
+  return (ndc * _aspectRatio + 1) * _cols / 2;  // Inverse of getNDCx
+}
+
+/**
+ * @brief Converts an NDC y-coordinate back to a canvas y-coordinate.
+ * @param ndc The NDC y-coordinate.
+ * @return The canvas y-coordinate, fractional between cells.
+ */
+float Canvas::getCanvasY(float ndc) const {
+  return (1 - ndc * CHAR_DIM) * _rows / 2;  // Inverse of getNDCy
 }
 
 /**
@@ -51,7 +112,32 @@ float Canvas::getNDCy(int y) {
  * @param y The y-coordinate (column) where the character will be drawn.
  */
 void Canvas::draw(char c, int x, int y) {
-  _strokes[x * _cols + y] = c;  // Place character in the appropriate position
+  size_t cell = static_cast<size_t>(x) * _stride + static_cast<size_t>(y) * _cellBytes;
+  _strokes[cell] = c;  // Place character in the appropriate position
+}
+
+/**
+ * @brief Draws a UTF-8 glyph at the specified (x, y) position on the canvas.
+ * @param glyph The cellBytes() bytes of the glyph.
+ * @param x The x-coordinate (row) where the glyph will be drawn.
+ * @param y The y-coordinate (column) where the glyph will be drawn.
+ */
+void Canvas::draw(const char *glyph, int x, int y) {
+  size_t cell = static_cast<size_t>(x) * _stride + static_cast<size_t>(y) * _cellBytes;
+  std::memcpy(&_strokes[cell], glyph, _cellBytes);  // Copy every byte of the glyph
+}
+
+/**
+ * @brief Sets the colours of the cell at the specified (x, y) position.
+ * @param x The x-coordinate (row) of the cell.
+ * @param y The y-coordinate (column) of the cell.
+ * @param fg The foreground colour as 0xRRGGBB, or COLOR_DEFAULT.
+ * @param bg The background colour as 0xRRGGBB, or COLOR_DEFAULT.
+ */
+void Canvas::setColor(int x, int y, uint32_t fg, uint32_t bg) {
+  size_t cell = 2 * (static_cast<size_t>(x) * static_cast<size_t>(_cols) + y);
+  _colors[cell] = fg;
+  _colors[cell + 1] = bg;
 }
 
 /**
@@ -60,14 +146,26 @@ void Canvas::draw(char c, int x, int y) {
  * @param i The index in the stroke array where the character will be drawn.
  */
 void Canvas::draw(char c, int i) {
-  _strokes[i] = c;  // Place character in the specified index
+  _strokes[offset(i)] = c;  // Place character in the specified index
 }
 
 /**
  * @brief Clears the canvas by resetting all strokes to empty spaces.
  */
 void Canvas::clear() {
-  _strokes.assign(_rows * _cols, ' ');  // Reset canvas to empty state
+  if (_cellBytes == 1) {
+    std::fill(_strokes.begin(), _strokes.end(), ' ');  // Reset canvas to empty state
+  } else {
+    for (size_t row = 0; row + _stride <= _strokes.size(); row += _stride) {
+      for (size_t cell = row; cell + _cellBytes < row + _stride; cell += _cellBytes) {
+        std::memcpy(&_strokes[cell], CELL_UTF8_BLANK, _cellBytes);  // A space would be narrower than a glyph
+      }
+    }
+  }
+  for (size_t end = _stride; end > 0 && end <= _strokes.size(); end += _stride) {
+    _strokes[end - 1] = '\n';  // Terminate every row
+  }
+  std::fill(_colors.begin(), _colors.end(), COLOR_DEFAULT);
 }
 
 /**
@@ -76,7 +174,7 @@ void Canvas::clear() {
  * @return A reference to the stroke character at the specified index.
  */
 char& Canvas::operator[](size_t index) {
-  return _strokes[index];  // Return reference for modification
+  return _strokes[offset(index)];  // Return reference for modification
 }
 
 /**
@@ -85,7 +183,88 @@ char& Canvas::operator[](size_t index) {
  * @return A constant reference to the stroke character at the specified index.
  */
 const char& Canvas::operator[](size_t index) const {
-  return _strokes[index];  // Return const reference for read-only access
+  return _strokes[offset(index)];  // Return const reference for read-only access
+}
+
+/**
+ * @brief Retrieves the printable contents of the canvas.
+ * @return The first byte of the first row.
+ */
+const char* Canvas::data() const {
+  return _strokes.data();
+}
+
+/**
+ * @brief Returns the number of bytes in data().
+ * @return rows() * stride().
+ */
+size_t Canvas::size() const {
+  return _strokes.size();
+}
+
+/**
+ * @brief Returns the distance between the starts of two rows in data().
+ * @return cols() * cellBytes() + 1, for the line terminator.
+ */
+int Canvas::stride() const {
+  return _stride;
+}
+
+/**
+ * @brief Returns the number of bytes every cell takes in data().
+ * @return 1 for ASCII, CELL_UTF8 for UTF-8 glyphs.
+ */
+int Canvas::cellBytes() const {
+  return _cellBytes;
+}
+
+/**
+ * @brief Returns how the colours of the canvas reach the terminal.
+ * @return The colour mode, ColorMode::None without colours.
+ */
+ColorMode Canvas::colorMode() const {
+  return _colorMode;
+}
+
+/**
+ * @brief Retrieves the colours of the cells.
+ * @return The foreground and background of every cell, or nullptr without colours.
+ */
+const uint32_t* Canvas::colors() const {
+  return _colors.empty() ? nullptr : _colors.data();
+}
+
+/**
+ * @brief Retrieves the colours of the cells for writing.
+ * @return The foreground and background of every cell, or nullptr without colours.
+ */
+uint32_t* Canvas::colors() {
+  return _colors.empty() ? nullptr : _colors.data();
+}
+
+/**
+ * @brief Checks whether two canvases have the same size, cell width and colour mode.
+ * @param other The canvas to compare with.
+ * @return True if one canvas can stand in for the other.
+ */
+bool Canvas::sameLayout(const Canvas& other) const {
+  return _rows == other._rows && _cols == other._cols && _cellBytes == other._cellBytes &&
+         _colorMode == other._colorMode;
+}
+
+/**
+ * @brief Exchanges the contents of two canvases without copying them.
+ * @param other The canvas to swap with.
+ */
+void Canvas::swap(Canvas& other) {
+  std::swap(_aspectRatio, other._aspectRatio);
+  std::swap(_rows, other._rows);
+  std::swap(_cols, other._cols);
+  std::swap(_cellBytes, other._cellBytes);
+  std::swap(_stride, other._stride);
+  _strokes.swap(other._strokes);
+  std::swap(_colorMode, other._colorMode);
+  _colors.swap(other._colors);
 }
 
 /**
@@ -95,11 +274,7 @@ const char& Canvas::operator[](size_t index) const {
  * @return The output stream with the canvas contents.
  */
 std::ostream& operator<<(std::ostream& os, Canvas& c) {
-  std::string output = c._strokes;  // Create a copy of strokes for output
-  for (int i = c._rows; i > 0; i--) {
-    output.insert(i * c._cols, "\n");  // Insert newline characters for row formatting
-  }
+  os.write(c._strokes.data(), c._strokes.size());  // Rows already end in line terminators
   c.clear();  // Clear the canvas after outputting
-  os << output;  // Write the formatted output to the stream
   return os;  // Return the output stream
 }
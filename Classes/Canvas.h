@@ -1,9 +1,24 @@
 #ifndef _CANVAS_H_
 #define _CANVAS_H_
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <vector>
 
 #define CHAR_DIM 4  // Constant defining character dimensions for NDC calculations
+#define CELL_UTF8 3  // Bytes of a cell holding a three-byte UTF-8 glyph
+#define CELL_UTF8_BLANK "\xE2\xA0\x80"  // U+2800, the empty Braille pattern, blanks a UTF-8 cell
+#define COLOR_DEFAULT 0xFF000000u  // The terminal's own colour, in place of a 0xRRGGBB value
+
+/**
+ * @brief How the colours of a canvas reach the terminal.
+ */
+enum class ColorMode {
+  None,        ///< No colours, only characters
+  Palette256,  ///< Colours quantized to the xterm 256-colour palette
+  TrueColor    ///< 24-bit colours
+};
 
 /**
  * @brief The Canvas class represents a drawable canvas for rendering characters.
@@ -13,15 +28,35 @@ class Canvas {
   float _aspectRatio;  // Aspect ratio of the canvas
   float _rows;         // Number of rows in the canvas
   float _cols;         // Number of columns in the canvas
-  std::string _strokes; // Stores the characters (strokes) drawn on the canvas
+  int _cellBytes;      // Bytes per cell: 1 for ASCII, CELL_UTF8 for UTF-8 glyphs
+  int _stride;         // Bytes per row, the line terminator included
+  std::string _strokes; // Stores the characters (strokes) drawn on the canvas, each row ending in '\n'
+  ColorMode _colorMode; // How the colours reach the terminal
+  std::vector<uint32_t> _colors; // Foreground and background of every cell, empty without colours
+
+  // Position of a cell in _strokes
+  size_t offset(size_t index) const;
 
  public:
   /**
    * @brief Constructs a Canvas object with specified dimensions.
    * @param rows The number of rows in the canvas.
    * @param cols The number of columns in the canvas.
+   * @param cellBytes The bytes of every cell: 1 for ASCII, CELL_UTF8 for UTF-8 glyphs.
+   * @param colorMode How the colours of the cells reach the terminal, if at all.
    */
-  Canvas(int rows, int cols);
+  Canvas(int rows, int cols, int cellBytes = 1, ColorMode colorMode = ColorMode::None);
+
+  /**
+   * @brief Changes the dimensions and layout of the canvas and clears it.
+   * The buffers keep their capacity, so shrinking and growing back to an
+   * earlier size never reallocates.
+   * @param rows The number of rows in the canvas.
+   * @param cols The number of columns in the canvas.
+   * @param cellBytes The bytes of every cell: 1 for ASCII, CELL_UTF8 for UTF-8 glyphs.
+   * @param colorMode How the colours of the cells reach the terminal, if at all.
+   */
+  void reshape(int rows, int cols, int cellBytes, ColorMode colorMode);
 
   /**
    * @brief Returns the number of rows in the canvas.
@@ -37,17 +72,39 @@ class Canvas {
 
   /**
    * @brief Converts a canvas x-coordinate to Normalized Device Coordinates (NDC).
-   * @param x The x-coordinate on the canvas.
+   * @param x The x-coordinate on the canvas, fractional between cells.
    * @return The NDC x-coordinate.
    */
-  float getNDCx(int x);
+  float getNDCx(float x) const;
 
   /**
    * @brief Converts a canvas y-coordinate to Normalized Device Coordinates (NDC).
-   * @param y The y-coordinate on the canvas.
+   * @param y The y-coordinate on the canvas, fractional between cells.
    * @return The NDC y-coordinate.
    */
-  float getNDCy(int y);
+  float getNDCy(float y) const;
+
+  /**
+   * @brief Overrides the aspect ratio derived from the dimensions.
+   * An aspect ratio of rows() * CHAR_DIM / cols() makes the cells square,
+   * as the pixels of an image are. The next reshape derives it again.
+   * @param aspectRatio The aspect ratio getNDCx() divides by.
+   */
+  void setAspectRatio(float aspectRatio);
+
+  /**
+   * @brief Converts an NDC x-coordinate back to a canvas x-coordinate.
+   * @param ndc The NDC x-coordinate.
+   * @return The canvas x-coordinate, fractional between cells.
+   */
+  float getCanvasX(float ndc) const;
+
+  /**
+   * @brief Converts an NDC y-coordinate back to a canvas y-coordinate.
+   * @param ndc The NDC y-coordinate.
+   * @return The canvas y-coordinate, fractional between cells.
+   */
+  float getCanvasY(float ndc) const;
 
   /**
    * @brief Draws a character at the specified (x, y) position on the canvas.
@@ -57,34 +114,114 @@ class Canvas {
    */
   void draw(char c, int x, int y);
 
+  /**
+   * @brief Draws a UTF-8 glyph at the specified (x, y) position on the canvas.
+   * @param glyph The cellBytes() bytes of the glyph.
+   * @param x The x-coordinate (row) where the glyph will be drawn.
+   * @param y The y-coordinate (column) where the glyph will be drawn.
+   */
+  void draw(const char *glyph, int x, int y);
+
+  /**
+   * @brief Sets the colours of the cell at the specified (x, y) position.
+   * Only meaningful when the canvas has a colour mode.
+   * @param x The x-coordinate (row) of the cell.
+   * @param y The y-coordinate (column) of the cell.
+   * @param fg The foreground colour as 0xRRGGBB, or COLOR_DEFAULT.
+   * @param bg The background colour as 0xRRGGBB, or COLOR_DEFAULT.
+   */
+  void setColor(int x, int y, uint32_t fg, uint32_t bg);
+
   /**
    * @brief Draws a character at the specified index on the canvas.
    * @param c The character to draw.
-   * @param i The index in the stroke array where the character will be drawn.
+   * @param i The index of the cell, counted row by row, where the character will be drawn.
    */
   void draw(char c, int i);
 
   /**
    * @brief Clears the canvas by resetting all strokes to empty spaces.
+   * UTF-8 cells are blanked with CELL_UTF8_BLANK and colours go back to
+   * COLOR_DEFAULT. The line terminators are kept and nothing is reallocated.
    */
   void clear();
 
   /**
    * @brief Overloads the subscript operator to access canvas strokes.
-   * @param index The index of the stroke to access.
-   * @return A reference to the stroke character at the specified index.
+   * @param index The index of the cell, counted row by row.
+   * @return A reference to the first byte of the stroke at the specified index.
    */
   char& operator[](size_t index);
 
   /**
    * @brief Overloads the subscript operator to access canvas strokes (const version).
-   * @param index The index of the stroke to access.
-   * @return A constant reference to the stroke character at the specified index.
+   * @param index The index of the cell, counted row by row.
+   * @return A constant reference to the first byte of the stroke at the specified index.
    */
   const char& operator[](size_t index) const;
 
+  /**
+   * @brief Retrieves the printable contents of the canvas.
+   * Rows are stride() bytes apart and each one ends in '\n', so the whole
+   * canvas can be written to a terminal as it is.
+   * @return The first byte of the first row.
+   */
+  const char* data() const;
+
+  /**
+   * @brief Returns the number of bytes in data().
+   * @return rows() * stride().
+   */
+  size_t size() const;
+
+  /**
+   * @brief Returns the distance between the starts of two rows in data().
+   * @return cols() * cellBytes() + 1, for the line terminator.
+   */
+  int stride() const;
+
+  /**
+   * @brief Returns the number of bytes every cell takes in data().
+   * @return 1 for ASCII, CELL_UTF8 for UTF-8 glyphs.
+   */
+  int cellBytes() const;
+
+  /**
+   * @brief Returns how the colours of the canvas reach the terminal.
+   * @return The colour mode, ColorMode::None without colours.
+   */
+  ColorMode colorMode() const;
+
+  /**
+   * @brief Retrieves the colours of the cells.
+   * @return The foreground and background of every cell, cell by cell and row by row,
+   *         or nullptr without colours.
+   */
+  const uint32_t* colors() const;
+
+  /**
+   * @brief Retrieves the colours of the cells for writing.
+   * @return The foreground and background of every cell, cell by cell and row by row,
+   *         or nullptr without colours.
+   */
+  uint32_t* colors();
+
+  /**
+   * @brief Checks whether two canvases have the same size, cell width and colour mode.
+   * @param other The canvas to compare with.
+   * @return True if one canvas can stand in for the other.
+   */
+  bool sameLayout(const Canvas& other) const;
+
+  /**
+   * @brief Exchanges the contents of two canvases without copying them.
+   * @param other The canvas to swap with.
+   */
+  void swap(Canvas& other);
+
   /**
    * @brief Overloads the output stream operator to print the canvas.
+   * The strokes are written as they are stored, in a single call.
    * @param os The output stream.
    * @param c The canvas to output.
    * @return The output stream with the canvas contents.
@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <cmath>
+#include "EdgeDetector.h"
+#include "Simd.h"
+
+// Outline characters for vertical, rising, horizontal and falling edges
+static const char OUTLINE_ASCII[] = "|/-\\";
+static const char *const OUTLINE_UTF8[] = {"\xE2\x94\x82", "\xE2\x95\xB1", "\xE2\x94\x80", "\xE2\x95\xB2"};
+
+// Gathers one row of cells into its ring slot and runs the horizontal passes over it
+void EdgeDetector::prepareRow(const ShadingBuffer &samples, int row, int cells, int subRows, int subCols, int slot) {
+  const int guard = SIMD_WIDTH;
+  const size_t sampleRow = static_cast<size_t>(row * subRows + subRows / 2) * samples.stride() + subCols / 2;
+  const float *sources[EDGE_CHANNELS] = {samples.depth() + sampleRow, samples.normals(0) + sampleRow,
+                                         samples.normals(1) + sampleRow, samples.normals(2) + sampleRow};
+
+  for (int c = 0; c < EDGE_CHANNELS; c++) {
+    float *values = &_values[c][static_cast<size_t>(slot) * _width];
+    for (int j = 0; j < cells; j++) {
+      values[guard + j] = sources[c][j * subCols];
+    }
+    std::fill(values, values + guard, values[guard]);
+    std::fill(values + guard + cells, values + _width, values[guard + cells - 1]);
+    if (c == 0) {
+      // Inverse depth is linear across a plane and 0 where nothing was hit
+      const floatv one = broadcast(1.0f);
+      for (int x = 0; x < _width; x += SIMD_WIDTH) {
+        store(values + x, one / load(values + x));
+      }
+    }
+
+    float *diffs = &_diffs[c][static_cast<size_t>(slot) * _width];
+    float *sums = &_sums[c][static_cast<size_t>(slot) * _width];
+    for (int x = guard; x < _width - guard; x += SIMD_WIDTH) {
+      floatv left = load(values + x - 1), middle = load(values + x), right = load(values + x + 1);
+      store(diffs + x, right - left);
+      store(sums + x, left + middle + middle + right);
+    }
+  }
+}
+
+// Finds the edges of a frame and draws their outlines over the canvas
+void EdgeDetector::outline(const ShadingBuffer &samples, int subRows, int subCols, Canvas &canvas) {
+  const int rows = std::max(0, static_cast<int>(canvas.rows()));
+  const int cols = std::max(0, static_cast<int>(canvas.cols()));
+  if (rows == 0 || cols == 0) {
+    return;
+  }
+  const int guard = SIMD_WIDTH;
+  const int padded = (cols + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+  _width = guard + padded + guard;
+  for (int c = 0; c < EDGE_CHANNELS; c++) {
+    _values[c].resize(3 * static_cast<size_t>(_width));
+    _diffs[c].resize(3 * static_cast<size_t>(_width));
+    _sums[c].resize(3 * static_cast<size_t>(_width));
+  }
+
+  // Gradients count cells, which are taller than wide; this brings them to screen proportions
+  const float aspect = std::fabs(canvas.getNDCy(1) - canvas.getNDCy(0)) / std::fabs(canvas.getNDCx(1) - canvas.getNDCx(0));
+  const floatv two = broadcast(2.0f), zero = broadcast(0.0f);
+  const floatv depthCut = broadcast(EDGE_DEPTH * EDGE_DEPTH), normalCut = broadcast(EDGE_NORMAL * EDGE_NORMAL);
+  const floatv diagonal = broadcast(EDGE_DIAGONAL), stretch = broadcast(aspect), step = broadcast(EDGE_STEP);
+  const bool utf8 = canvas.cellBytes() != 1;
+
+  prepareRow(samples, 0, cols, subRows, subCols, 2);  // The row above the first repeats it
+  prepareRow(samples, 0, cols, subRows, subCols, 0);
+  for (int i = 0; i < rows; i++) {
+    prepareRow(samples, std::min(i + 1, rows - 1), cols, subRows, subCols, (i + 1) % 3);
+    const size_t above = static_cast<size_t>((i + 2) % 3) * _width;
+    const size_t centre = static_cast<size_t>(i % 3) * _width;
+    const size_t below = static_cast<size_t>((i + 1) % 3) * _width;
+
+    for (int x = guard; x < guard + padded; x += SIMD_WIDTH) {
+      // Vertical passes: [1 2 1] over the differences and [-1 0 1] over the sums
+      floatv gx[EDGE_CHANNELS], gy[EDGE_CHANNELS];
+      for (int c = 0; c < EDGE_CHANNELS; c++) {
+        gx[c] = load(&_diffs[c][above + x]) + two * load(&_diffs[c][centre + x]) + load(&_diffs[c][below + x]);
+        gy[c] = load(&_sums[c][below + x]) - load(&_sums[c][above + x]);
+      }
+
+      // A silhouette is a jump in depth large next to the cell's own; a crease is a jump in the normal
+      floatv inverse = load(&_values[0][centre + x]);
+      maskv hit = inverse > zero;
+      maskv silhouette = (gx[0] * gx[0] + gy[0] * gy[0] > depthCut * inverse * inverse) & hit;
+      floatv bend = zero, strongest = zero, nx = zero, ny = zero;
+      for (int c = 1; c < EDGE_CHANNELS; c++) {
+        floatv magnitude = gx[c] * gx[c] + gy[c] * gy[c];
+        maskv stronger = magnitude > strongest;
+        strongest = select(stronger, magnitude, strongest);
+        nx = select(stronger, gx[c], nx);
+        ny = select(stronger, gy[c], ny);
+        bend = bend + magnitude;
+      }
+      maskv crease = (bend > normalCut) & hit;
+      if (bits(silhouette | crease) == 0) {
+        continue;
+      }
+      floatv dx = select(silhouette, gx[0], nx), dy = select(silhouette, gy[0], ny);
+
+      // Sobel fires on both cells of a jump; the jump is drawn once, looking at the neighbours across it
+      maskv alongRow = abs(dx) >= abs(dy);
+      floatv forward = zero, backward = zero, nearer = zero;
+      for (int c = 0; c < EDGE_CHANNELS; c++) {
+        floatv middle = load(&_values[c][centre + x]);
+        floatv next = select(alongRow, load(&_values[c][centre + x + 1]), load(&_values[c][below + x]));
+        floatv previous = select(alongRow, load(&_values[c][centre + x - 1]), load(&_values[c][above + x]));
+        if (c == 0) {
+          // A silhouette belongs to the nearer side, the one whose inverse depth is larger
+          maskv ahead = abs(next - middle) >= abs(middle - previous);
+          nearer = select(ahead, next, previous);
+        } else {
+          // A crease belongs to the side before it; cells the operator reaches from further away see no step
+          forward = forward + (next - middle) * (next - middle);
+          backward = backward + (middle - previous) * (middle - previous);
+        }
+      }
+      int silhouettes = bits(silhouette & (inverse > nearer));
+      int edges = silhouettes | (bits(crease & (forward > step * backward)) & ~bits(silhouette));
+      if (edges == 0) {
+        continue;
+      }
+
+      // The outline runs across the gradient of the jump that found it
+      floatv across = abs(dx) * stretch, down = abs(dy);
+      int vertical = bits(down < diagonal * across);
+      int horizontal = bits(across < diagonal * down);
+      int rising = bits(dx * dy > zero);  // Rows count downwards, so a gradient down and right makes /
+      for (; edges != 0; edges &= edges - 1) {
+        int lane = __builtin_ctz(edges);
+        int j = x - guard + lane;
+        if (j >= cols) {
+          break;
+        }
+        int line = vertical >> lane & 1 ? 0 : horizontal >> lane & 1 ? 2 : rising >> lane & 1 ? 1 : 3;
+        if (utf8) {
+          canvas.draw(OUTLINE_UTF8[line], i, j);
+        } else {
+          canvas.draw(OUTLINE_ASCII[line], i, j);
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,56 @@
+#ifndef _EDGE_DETECTOR_H_
+#define _EDGE_DETECTOR_H_
+
+#include "CacheAligned.h"
+#include "Canvas.h"
+#include "ShadingBuffer.h"
+
+#define EDGE_CHANNELS 4       // Inverse depth and the three coordinates of the normal
+#define EDGE_DEPTH 0.5f       // Sobel response of the inverse depth, relative to the cell's own, marking a silhouette
+#define EDGE_NORMAL 1.5f      // Sobel response of the normals marking a crease; a right-angled one gives about 4
+#define EDGE_STEP 4.0f        // How much larger the squared step into a crease is than the one before it, so curved surfaces are not outlined
+#define EDGE_DIAGONAL 0.414f  // tan(22.5 degrees): edges closer than this to an axis are drawn straight
+
+/**
+ * @brief Outlines the silhouettes and creases of a frame with line characters.
+ * One sample per cell is looked at: its inverse depth, which is 0 where
+ * nothing was hit and changes linearly across a plane, and its normal. A
+ * 3x3 Sobel operator, split into a horizontal and a vertical pass, finds
+ * where either jumps. The horizontal pass runs a whole vector of cells at
+ * a time over a ring of three prepared rows, so the frame is read once and
+ * each row is filtered as soon as the row below it is ready. Of the two
+ * cells the operator marks across a jump only one is kept, the nearer one
+ * for a silhouette, so outlines are a cell wide. Cells on an edge get |, /,
+ * - or \ after the direction of the edge on screen, or their box-drawing
+ * equivalents on a UTF-8 canvas. No ray is traced.
+ */
+class EdgeDetector {
+ private:
+  int _width = 0;                                ///< Floats in a row of every ring, the cells plus a guard vector on each side
+  CacheAlignedVector<float> _values[EDGE_CHANNELS]; ///< Three rows of every channel, guards repeating the border cells
+  CacheAlignedVector<float> _diffs[EDGE_CHANNELS];  ///< Horizontal [-1 0 1] pass of the same rows
+  CacheAlignedVector<float> _sums[EDGE_CHANNELS];   ///< Horizontal [1 2 1] pass of the same rows
+
+  /**
+   * @brief Gathers one row of cells into its ring slot and runs the horizontal passes over it.
+   * @param samples The shading of the frame.
+   * @param row The cell row, clamped to the canvas so the border does not look like an edge.
+   * @param cells The number of cells in a row.
+   * @param subRows The sample rows in every cell.
+   * @param subCols The sample columns in every cell.
+   * @param slot The ring slot receiving the row.
+   */
+  void prepareRow(const ShadingBuffer &samples, int row, int cells, int subRows, int subCols, int slot);
+
+ public:
+  /**
+   * @brief Finds the edges of a frame and draws their outlines over the canvas.
+   * @param samples The shading of the frame, upscaled to the whole canvas.
+   * @param subRows The sample rows in every cell.
+   * @param subCols The sample columns in every cell.
+   * @param canvas The canvas already holding the frame.
+   */
+  void outline(const ShadingBuffer &samples, int subRows, int subCols, Canvas &canvas);
+};
+
+#endif //_EDGE_DETECTOR_H_
@@ -1,74 +1,95 @@
-#include <list>
 #include "Face.h"
 
 /**
- * @brief Default constructor for the Face class.
- * Initializes the normal pointer with a new Eigen vector.
+ * @brief Constructs a view of a face of a mesh.
+ * @param mesh The mesh holding the face.
+ * @param index The index of the face in the mesh.
  */
-Face::Face() : _normalPtr(std::make_shared<Eigen::Vector3d>()) {}
+Face::Face(const Mesh &mesh, unsigned int index) : _mesh(&mesh), _index(index) {}
 
 /**
- * @brief Constructs a Face object with a specified normal pointer.
- * @param normalPtr A shared pointer to the normal vector of the face.
+ * @brief Retrieves the number of vertices of the face.
+ * @return The vertex count.
  */
-Face::Face(v3DPtr normalPtr) : _normalPtr(std::move(normalPtr)) {}
+unsigned int Face::size() const {
+  return _mesh->faceSize(_index);
+}
 
 /**
- * @brief Adds a vertex pointer to the face.
- * @param vertexPtr A shared pointer to a vertex.
+ * @brief Retrieves the positions within the face of the vertices of one triangle.
+ * Triangles alternate between taking a vertex from the front and from the
+ * back of the remaining polygon, so the k-th one can be computed directly.
+ * Currently, this works under the assumption that the face is convex.
+ * @param k The index of the triangle, in [0, size() - 2).
+ * @return The positions of the triangle's vertices within the face.
  */
-void Face::push_back(const v3DPtr& vertexPtr) {
-  _v.push_back(vertexPtr);  // Add vertex to the list
+triangle Face::cornersAt(unsigned int k) const {
+  unsigned int front = (k + 1) / 2;                 // Vertices popped from the front so far
+  unsigned int back = size() - 1 - k / 2;           // Last vertex still in the polygon
+
+  if (k % 2 == 0 || k == size() - 3) {
+    return {front, front + 1, back};  // Pop the front (or handle the last three vertices)
+  }
+  return {back, front, back - 1};  // Pop the back
+}
+
+/**
+ * @brief Retrieves one triangle of the face's triangulation.
+ * @param k The index of the triangle, in [0, size() - 2).
+ * @return The vertex indices of the triangle.
+ */
+triangle Face::triangleAt(unsigned int k) const {
+  const unsigned int *v = _mesh->faceVertices(_index);
+  triangle corners = cornersAt(k);
+  return {v[corners[0]], v[corners[1]], v[corners[2]]};
 }
 
 /**
  * @brief Triangulates the face into a list of triangles.
  * Converts the face into triangles. Currently, this method works
  * under the assumption that the face is convex.
+ * @return The vertex indices of every triangle.
  */
-void Face::triangulate() {
-  // Converts a face into a list of triangles
-  std::list<v3DPtr> tempV(_v.begin(), _v.end());
-  bool popFlag = true;
-  v3DPtr v0, v1, v2;
-
-  while (tempV.size() != 3) {
-    if (popFlag) {
-      v0 = tempV.front();
-      tempV.pop_front();
-    } else {
-      v0 = tempV.back();
-      tempV.pop_back();
-    }
-    v1 = tempV.front();
-    v2 = tempV.back();
-    _triangles.push_back({v0, v1, v2});
-    popFlag = !popFlag;  // Alternate between front and back
+std::vector<triangle> Face::triangulate() const {
+  std::vector<triangle> triangles;
+  for (unsigned int k = 0; k + 2 < size(); k++) {
+    triangles.push_back(triangleAt(k));
   }
+  return triangles;
+}
 
-  // Handle the last three vertices
-  v0 = tempV.front();
-  tempV.pop_front();
-  v1 = tempV.front();
-  tempV.pop_front();
-  v2 = tempV.front();
-  _triangles.push_back({v0, v1, v2});
+/**
+ * @brief Retrieves the vertex indices of the face.
+ * @return The indices of the face's vertices in the mesh.
+ */
+std::vector<unsigned int> Face::getVerts() const {
+  const unsigned int *v = _mesh->faceVertices(_index);
+  return std::vector<unsigned int>(v, v + size());
 }
 
 /**
- * @brief Retrieves the vertices of the face.
- * @return A vector of shared pointers to the vertices.
+ * @brief Retrieves a vertex of the face.
+ * @param i The position of the vertex within the face.
+ * @return The position of the vertex.
  */
-std::vector<v3DPtr> Face::getVerts() {
-  return _v;  // Return the list of vertex pointers
+const Eigen::Vector3d &Face::getVert(unsigned int i) const {
+  return _mesh->position(_mesh->faceVertices(_index)[i]);
 }
 
 /**
- * @brief Retrieves the normal of the face.
- * @return A shared pointer to the normal vector.
+ * @brief Retrieves the normal at the face's first vertex.
+ * @return The normal vector.
  */
-v3DPtr Face::getNorm() {
-  return _normalPtr;  // Return the normal vector pointer
+const Eigen::Vector3d &Face::getNorm() const {
+  return _mesh->normal(getNormIndex());
+}
+
+/**
+ * @brief Retrieves the index in the mesh of the normal at the face's first vertex.
+ * @return The normal index.
+ */
+unsigned int Face::getNormIndex() const {
+  return _mesh->faceNormal(_index);
 }
 
 /**
@@ -76,39 +97,58 @@ v3DPtr Face::getNorm() {
  * @param orig The origin point of the ray.
  * @param dir The direction of the ray.
  * @param tri The triangle to test for intersection.
+ * @param hit Receives the ray parameter and barycentrics of the hit.
+ * @param tMax Hits at or beyond this ray parameter are rejected.
  * @return True if the ray intersects the triangle, otherwise false.
  */
-bool Face::triRayIntersectGEO(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir, const triangle &tri) {
-  double D = -_normalPtr->dot(*_v[0]);
-  double t = -(_normalPtr->dot(orig) + D) / _normalPtr->dot(dir);
+bool Face::triRayIntersectGEO(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir, const triangle &tri,
+                              Hit &hit, double tMax) const {
+  const Eigen::Vector3d &A = _mesh->position(tri[0]);
+  const Eigen::Vector3d &B = _mesh->position(tri[1]);
+  const Eigen::Vector3d &C = _mesh->position(tri[2]);
+  // The plane of the triangle itself, as the vertex normals may lean away from it
+  Eigen::Vector3d N = (B - A).cross(C - A);
+  double facing = N.dot(dir);
+  if (facing == 0)
+    return false;  // Ray is parallel to the triangle
+  double t = N.dot(A - orig) / facing;
+  if (!(t > EPSILON && t < tMax))
+    return false;
   const Eigen::Vector3d P = orig + t * dir;
 
-  Eigen::Vector3d edge0 = *(tri[1]) - *(tri[0]);
-  Eigen::Vector3d edge1 = *(tri[2]) - *(tri[1]);
-  Eigen::Vector3d edge2 = *(tri[0]) - *(tri[2]);
-  Eigen::Vector3d C0 = P - *(tri[0]);
-  Eigen::Vector3d C1 = P - *(tri[1]);
-  Eigen::Vector3d C2 = P - *(tri[2]);
+  Eigen::Vector3d edge0 = B - A;
+  Eigen::Vector3d edge1 = C - B;
+  Eigen::Vector3d edge2 = A - C;
+  Eigen::Vector3d C0 = P - A;
+  Eigen::Vector3d C1 = P - B;
+  Eigen::Vector3d C2 = P - C;
 
   // Check if the point P is inside the triangle using the normal
-  return _normalPtr->dot(edge0.cross(C0)) >= 0 &&
-         _normalPtr->dot(edge1.cross(C1)) >= 0 &&
-         _normalPtr->dot(edge2.cross(C2)) >= 0;
+  if (N.dot(edge0.cross(C0)) < 0 ||
+      N.dot(edge1.cross(C1)) < 0 ||
+      N.dot(edge2.cross(C2)) < 0)
+    return false;
+
+  // Barycentrics from the areas of the sub-triangles opposite each vertex
+  double area = N.dot(N);
+  hit.t = t;
+  hit.u = N.dot(edge2.cross(C2)) / area;
+  hit.v = N.dot(edge0.cross(C0)) / area;
+  hit.face = _index;
+  return true;
 }
 
 /**
  * @brief Checks for ray intersection with the face.
  * @param orig The origin point of the ray.
  * @param dir The direction of the ray.
+ * @param hit Receives the ray parameter, barycentrics and face of the hit.
+ * @param tMax Hits at or beyond this ray parameter are rejected.
  * @return True if the ray intersects any triangle of the face, otherwise false.
  */
-bool Face::intersectGEO(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir) {
-  if (_normalPtr->dot(orig - dir) == 0) {
-    return false;  // Ray is parallel to the face
-  }
-
-  for (const triangle &tri : _triangles) {
-    if (triRayIntersectGEO(orig, dir, tri)) {
+bool Face::intersectGEO(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir, Hit &hit, double tMax) const {
+  for (unsigned int k = 0; k + 2 < size(); k++) {
+    if (triRayIntersectGEO(orig, dir, triangleAt(k), hit, tMax)) {
       return true;  // Intersection found
     }
   }
@@ -120,31 +160,61 @@ bool Face::intersectGEO(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir)
  * @param orig The origin point of the ray.
  * @param dir The direction of the ray.
  * @param tri The triangle to test for intersection.
+ * @param hit Receives the ray parameter and barycentrics of the hit.
+ * @param tMax Hits at or beyond this ray parameter are rejected.
  * @return True if the ray intersects the triangle, otherwise false.
  */
-bool Face::triRayIntersectMT(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir, const triangle &tri) {
-  Eigen::Vector3d AB = *(tri[1]) - *(tri[0]);
-  Eigen::Vector3d AC = *(tri[2]) - *(tri[0]);
+bool Face::triRayIntersectMT(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir, const triangle &tri,
+                             Hit &hit, double tMax) const {
+  double t, u, v;
+  if (!rayTriangleMT(orig, dir, _mesh->position(tri[0]), _mesh->position(tri[1]), _mesh->position(tri[2]), t, u, v))
+    return false;
+  if (!(t > EPSILON && t < tMax))
+    return false;
+
+  hit.t = t;
+  hit.u = u;
+  hit.v = v;
+  hit.face = _index;
+  return true;
+}
+
+/**
+ * @brief Möller–Trumbore test that reports the hit instead of storing it.
+ * @param orig The origin point of the ray.
+ * @param dir The direction of the ray.
+ * @param a The first vertex of the triangle.
+ * @param b The second vertex of the triangle.
+ * @param c The third vertex of the triangle.
+ * @param t Receives the ray parameter of the hit, in units of dir.
+ * @param u Receives the barycentric weight of b.
+ * @param v Receives the barycentric weight of c.
+ * @return True if the ray's line intersects the triangle, otherwise false.
+ */
+bool Face::rayTriangleMT(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir,
+                         const Eigen::Vector3d &a, const Eigen::Vector3d &b, const Eigen::Vector3d &c,
+                         double &t, double &u, double &v) {
+  Eigen::Vector3d AB = b - a;
+  Eigen::Vector3d AC = c - a;
   Eigen::Vector3d pvec = dir.cross(AC);
   double det = AB.dot(pvec);
 
-  if (abs(det) < EPSILON)  // If the ray and triangle are parallel
+  if (std::abs(det) < EPSILON)  // If the ray and triangle are parallel
     return false;
 
   double invDet = 1 / det;
 
-  Eigen::Vector3d tvec = orig - *(tri[0]);
-  double u = tvec.dot(pvec) * invDet;
+  Eigen::Vector3d tvec = orig - a;
+  u = tvec.dot(pvec) * invDet;
   if (u < 0 || u > 1)
     return false;
 
   Eigen::Vector3d qvec = tvec.cross(AB);
-  double v = dir.dot(qvec) * invDet;
+  v = dir.dot(qvec) * invDet;
   if (v < 0 || u + v > 1)
     return false;
 
-  double t = AC.dot(qvec) * invDet;
-  _pIntersect = orig + t * dir;  // Calculate intersection point
+  t = AC.dot(qvec) * invDet;
   return true;
 }
 
@@ -152,21 +222,15 @@ bool Face::triRayIntersectMT(const Eigen::Vector3d &orig, const Eigen::Vector3d
  * @brief Checks for ray intersection with the face using a more optimized method.
  * @param orig The origin point of the ray.
  * @param dir The direction of the ray.
+ * @param hit Receives the ray parameter, barycentrics and face of the hit.
+ * @param tMax Hits at or beyond this ray parameter are rejected.
  * @return True if the ray intersects any triangle of the face, otherwise false.
  */
-bool Face::intersectMT(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir)
+bool Face::intersectMT(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir, Hit &hit, double tMax) const
 {
-  for (const triangle &tri : _triangles) {
-    if (triRayIntersectMT(orig, dir, tri))
+  for (unsigned int k = 0; k + 2 < size(); k++) {
+    if (triRayIntersectMT(orig, dir, triangleAt(k), hit, tMax))
       return true;  // Intersection found
   }
   return false;  // No intersection
 }
-
-/**
- * @brief Retrieves the intersection point of the ray with the face.
- * @return The intersection point.
- */
-Eigen::Vector3d &Face::getIntersect() {
-  return _pIntersect;  // Return the intersection point
-}
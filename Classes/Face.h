@@ -1,104 +1,144 @@
 #ifndef _FACE_H_
 #define _FACE_H_
 
-#include <memory>
+#include <cmath>
 #include <vector>
 #include <Eigen/Dense>
+#include "Mesh.h"
+#include "Hit.h"
 
 #define EPSILON 0.00000001  // A small value to handle floating-point comparisons
 
-typedef std::shared_ptr<Eigen::Vector3d> v3DPtr;  // Shared pointer type for a 3D vector
-typedef std::array<v3DPtr, 3> triangle;  // Array type to represent a triangle as three vertices
-
 /**
  * @brief Class representing a geometric face in 3D space.
- * This class stores vertices, normal vector, and provides methods for
- * triangulation and ray intersection testing.
+ * A Face is a lightweight view of one face of a Mesh. It provides methods
+ * for triangulation and reference ray intersection testing.
  */
 class Face {
  private:
-  std::vector<v3DPtr> _v;  ///< List of vertices making up the face
-  std::vector<triangle> _triangles;  ///< List of triangles derived from the face
-  v3DPtr _normalPtr;  ///< Pointer to the normal vector of the face
-  Eigen::Vector3d _pIntersect;  ///< Point of intersection, if any
+  const Mesh *_mesh;  ///< Mesh the face belongs to
+  unsigned int _index;  ///< Index of the face in the mesh
 
  public:
   /**
-   * @brief Default constructor for the Face class.
-   * Initializes the normal pointer with a new Eigen vector.
+   * @brief Constructs a view of a face of a mesh.
+   * @param mesh The mesh holding the face.
+   * @param index The index of the face in the mesh.
+   */
+  Face(const Mesh &mesh, unsigned int index);
+
+  /**
+   * @brief Retrieves the number of vertices of the face.
+   * @return The vertex count.
    */
-  Face();
+  unsigned int size() const;
 
   /**
-   * @brief Constructs a Face object with a specified normal pointer.
-   * @param normal A shared pointer to the normal vector of the face.
+   * @brief Retrieves the vertex indices of the face.
+   * @return The indices of the face's vertices in the mesh.
    */
-  Face(v3DPtr normal);
+  std::vector<unsigned int> getVerts() const;
 
   /**
-   * @brief Adds a vertex pointer to the face.
-   * @param vertex A shared pointer to a vertex.
+   * @brief Retrieves a vertex of the face.
+   * @param i The position of the vertex within the face.
+   * @return The position of the vertex.
    */
-  void push_back(const v3DPtr& vertex);
+  const Eigen::Vector3d &getVert(unsigned int i) const;
 
   /**
-   * @brief Retrieves the vertices of the face.
-   * @return A vector of shared pointers to the vertices.
+   * @brief Retrieves the normal at the face's first vertex.
+   * @return The normal vector.
    */
-  std::vector<v3DPtr> getVerts();
+  const Eigen::Vector3d &getNorm() const;
 
   /**
-   * @brief Retrieves the normal of the face.
-   * @return A shared pointer to the normal vector.
+   * @brief Retrieves the index in the mesh of the normal at the face's first vertex.
+   * @return The normal index.
    */
-  v3DPtr getNorm();
+  unsigned int getNormIndex() const;
 
   /**
    * @brief Checks for ray intersection with the face using geometric methods.
    * @param orig The origin point of the ray.
    * @param dir The direction of the ray.
+   * @param hit Receives the ray parameter, barycentrics and face of the hit.
+   * @param tMax Hits at or beyond this ray parameter are rejected.
    * @return True if the ray intersects any triangle of the face, otherwise false.
    */
-  bool intersectGEO(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir);
+  bool intersectGEO(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir, Hit &hit, double tMax = INFINITY) const;
 
   /**
    * @brief Checks if a ray intersects with a triangle using geometric methods.
    * @param orig The origin point of the ray.
    * @param dir The direction of the ray.
    * @param tri The triangle to test for intersection.
+   * @param hit Receives the ray parameter and barycentrics of the hit.
+   * @param tMax Hits at or beyond this ray parameter are rejected.
    * @return True if the ray intersects the triangle, otherwise false.
    */
-  bool triRayIntersectGEO(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir, const triangle &tri);
+  bool triRayIntersectGEO(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir, const triangle &tri,
+                          Hit &hit, double tMax = INFINITY) const;
+
+  /**
+   * @brief Retrieves the positions within the face of the vertices of one triangle.
+   * @param k The index of the triangle, in [0, size() - 2).
+   * @return The positions of the triangle's vertices within the face.
+   */
+  triangle cornersAt(unsigned int k) const;
+
+  /**
+   * @brief Retrieves one triangle of the face's triangulation.
+   * @param k The index of the triangle, in [0, size() - 2).
+   * @return The vertex indices of the triangle.
+   */
+  triangle triangleAt(unsigned int k) const;
 
   /**
    * @brief Triangulates the face into a list of triangles.
    * Converts the face into triangles. Currently, this method works
    * under the assumption that the face is convex.
+   * @return The vertex indices of every triangle.
    */
-  void triangulate();
+  std::vector<triangle> triangulate() const;
 
   /**
    * @brief Checks for ray intersection with the face using a more optimized method.
    * @param orig The origin point of the ray.
    * @param dir The direction of the ray.
+   * @param hit Receives the ray parameter, barycentrics and face of the hit.
+   * @param tMax Hits at or beyond this ray parameter are rejected.
    * @return True if the ray intersects any triangle of the face, otherwise false.
    */
-  bool intersectMT(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir);
+  bool intersectMT(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir, Hit &hit, double tMax = INFINITY) const;
 
   /**
    * @brief Checks if a ray intersects with a triangle using a more optimized method.
    * @param orig The origin point of the ray.
    * @param dir The direction of the ray.
    * @param tri The triangle to test for intersection.
+   * @param hit Receives the ray parameter and barycentrics of the hit.
+   * @param tMax Hits at or beyond this ray parameter are rejected.
    * @return True if the ray intersects the triangle, otherwise false.
    */
-  bool triRayIntersectMT(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir, const triangle &tri);
+  bool triRayIntersectMT(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir, const triangle &tri,
+                         Hit &hit, double tMax = INFINITY) const;
 
   /**
-   * @brief Retrieves the intersection point of the ray with the face.
-   * @return The intersection point.
+   * @brief Möller–Trumbore test that reports the hit instead of storing it.
+   * @param orig The origin point of the ray.
+   * @param dir The direction of the ray.
+   * @param a The first vertex of the triangle.
+   * @param b The second vertex of the triangle.
+   * @param c The third vertex of the triangle.
+   * @param t Receives the ray parameter of the hit, in units of dir.
+   * @param u Receives the barycentric weight of b.
+   * @param v Receives the barycentric weight of c.
+   * @return True if the ray's line intersects the triangle, otherwise false.
    */
-  Eigen::Vector3d &getIntersect();
+  static bool rayTriangleMT(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir,
+                            const Eigen::Vector3d &a, const Eigen::Vector3d &b, const Eigen::Vector3d &c,
+                            double &t, double &u, double &v);
 };
 
 #endif //_FACE_H_
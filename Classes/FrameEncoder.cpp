@@ -0,0 +1,332 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sys/uio.h>
+#include "FrameEncoder.h"
+
+// Colours the terminal starts every frame with
+static const uint64_t DEFAULT_COLORS = static_cast<uint64_t>(COLOR_DEFAULT) << 32 | COLOR_DEFAULT;
+
+// Bytes of the largest frame a canvas of this layout can be encoded to
+static size_t frameBound(const Canvas &canvas) {
+  const size_t rows = canvas.rows(), cols = canvas.cols();
+  const int gap = std::max(1, DIFF_GAP / canvas.cellBytes());
+  // Changed runs are more than a gap apart, and each starts with the longest cursor movement
+  const size_t runs = (cols + gap) / (gap + 1);
+  const size_t move = 4 + std::to_string(rows).size() + std::to_string(cols).size();
+  const size_t sgr = canvas.colors() != nullptr ? SGR_MAX : 0;
+  const size_t row = cols * (canvas.cellBytes() + sgr) + runs * move + 1;
+  return 16 + rows * row;  // Clearing, homing and resetting the colours around the rows
+}
+
+// Number of decimal digits of a colour component or palette index
+static size_t digits(uint32_t value) {
+  return value >= 100 ? 3 : value >= 10 ? 2 : 1;
+}
+
+// Bytes setColors() spends on one of the two colours of an escape
+static size_t colorLength(uint32_t color, bool trueColor) {
+  if (color == COLOR_DEFAULT) {
+    return 2;  // 39 or 49
+  }
+  if (trueColor) {
+    // 38;2;R;G;B
+    return 7 + digits(color >> 16 & 0xFF) + digits(color >> 8 & 0xFF) + digits(color & 0xFF);
+  }
+  return 5 + digits(color);  // 38;5;N
+}
+
+// Encodes the update from the canvas on screen to a new one
+void FrameEncoder::encode(Canvas &canvas) {
+  int rows = static_cast<int>(canvas.rows());
+  int cols = static_cast<int>(canvas.cols());
+  const bool colored = canvas.colors() != nullptr;
+  _frame.clear();
+  _body = nullptr;
+  _bodySize = 0;
+  _sgr = DEFAULT_COLORS;
+  _trueColor = canvas.colorMode() == ColorMode::TrueColor;
+  if (colored) {
+    mapColors(canvas);
+  }
+
+  // A new layout needs a buffer of its own, copied once
+  const bool newLayout = !canvas.sameLayout(_previous);
+  if (newLayout) {
+    _previous = canvas;
+    _frame.reserve(frameBound(canvas));  // However large a diff gets, it never grows the buffer
+  }
+
+  if (newLayout || !_valid) {
+    _frame = colored ? "\033[0m\033[2J" : "\033[2J";  // Nothing is known about the screen
+    encodeFull(newLayout ? _previous : canvas);
+  } else {
+    // Anything longer than a full redraw is not worth sending
+    const size_t fullSize = colored ? coloredFullSize(canvas) : 3 + canvas.size();
+    const int stride = canvas.stride();
+    const int width = canvas.cellBytes();
+    const int gap = std::max(1, DIFF_GAP / width);
+    bool full = false;
+    _cursorRow = -1;
+    for (int i = 0; i < rows && !full; i++) {
+      const char *cur = canvas.data() + static_cast<size_t>(i) * stride;
+      const char *prev = _previous.data() + static_cast<size_t>(i) * stride;
+      const uint64_t *curColors = colored ? &_colors[static_cast<size_t>(i) * cols] : nullptr;
+      const uint64_t *prevColors = colored ? &_previousColors[static_cast<size_t>(i) * cols] : nullptr;
+      // Cells are compared whole, so a UTF-8 glyph is never split
+      auto changed = [&](int k) {
+        if (colored && curColors[k] != prevColors[k]) {
+          return true;
+        }
+        return width == 1 ? cur[k] != prev[k] : std::memcmp(cur + k * width, prev + k * width, width) != 0;
+      };
+      int j = 0;
+      while (j < cols) {
+        if (!changed(j)) {
+          j++;
+          continue;
+        }
+        // Extend the run over short stretches of unchanged cells
+        int start = j, end = j + 1;
+        for (int k = end; k < cols && k - end < gap; k++) {
+          if (changed(k)) {
+            end = k + 1;
+          }
+        }
+        moveTo(i, start);
+        if (colored) {
+          appendColored(canvas, i, start, end);
+        } else {
+          _frame.append(cur + start * width, (end - start) * width);
+        }
+        _cursorCol = end;
+        j = end;
+      }
+      full = _frame.size() >= fullSize;
+    }
+    if (full) {
+      _frame.clear();
+      _sgr = DEFAULT_COLORS;
+      encodeFull(canvas);
+    }
+  }
+  if (_sgr != DEFAULT_COLORS) {
+    _frame += "\033[0m";  // Leave the terminal as it was for anything printed between frames
+  }
+  if (!newLayout) {
+    _previous.swap(canvas);
+  }
+  if (_body != nullptr) {
+    // A small canvas keeps its bytes inline, so the swap moved them rather than the buffer
+    _body = _previous.data();
+  }
+  _previousColors.swap(_colors);
+  _valid = true;
+}
+
+// Encodes the whole canvas, homing the cursor first
+void FrameEncoder::encodeFull(const Canvas &canvas) {
+  _frame += "\033[H";
+  int rows = static_cast<int>(canvas.rows());
+  if (canvas.colors() != nullptr) {
+    // Colours are interleaved with the cells, so the canvas is copied row by row
+    for (int i = 0; i < rows; i++) {
+      if (i > 0) {
+        _frame += '\n';
+      }
+      appendColored(canvas, i, 0, static_cast<int>(canvas.cols()));
+    }
+    return;
+  }
+  // The canvas goes out as it is; dropping the last newline keeps the screen from scrolling
+  _body = canvas.data();
+  _bodySize = canvas.size() > 0 ? canvas.size() - 1 : 0;
+}
+
+// Counts the bytes encodeFull() would take for a coloured canvas, escapes included
+size_t FrameEncoder::coloredFullSize(const Canvas &canvas) const {
+  const size_t cells = _colors.size();
+  // Homing the cursor, every cell and the newlines between the rows
+  size_t size = 3 + cells * canvas.cellBytes() + (canvas.rows() > 0 ? canvas.rows() - 1 : 0);
+  // Follows the colours as appendColored() sets them, without building the escapes
+  uint64_t sgr = DEFAULT_COLORS;
+  for (size_t cell = 0; cell < cells; cell++) {
+    uint64_t target = _colors[cell];
+    if (static_cast<uint32_t>(target >> 32) == COLOR_DEFAULT) {
+      target = (sgr & 0xFFFFFFFF00000000ull) | (target & 0xFFFFFFFFull);
+    }
+    if (target == sgr) {
+      continue;
+    }
+    uint32_t fg = static_cast<uint32_t>(target >> 32), bg = static_cast<uint32_t>(target);
+    bool fgChanged = fg != static_cast<uint32_t>(sgr >> 32), bgChanged = bg != static_cast<uint32_t>(sgr);
+    size += 3;  // \033[ and m
+    size += fgChanged ? colorLength(fg, _trueColor) : 0;
+    size += bgChanged ? colorLength(bg, _trueColor) : 0;
+    size += fgChanged && bgChanged ? 1 : 0;
+    sgr = target;
+  }
+  return sgr != DEFAULT_COLORS ? size + 4 : size;  // Resetting the colours after the last row
+}
+
+// Maps the colours of every cell to the ones the terminal will show
+void FrameEncoder::mapColors(const Canvas &canvas) {
+  int rows = static_cast<int>(canvas.rows());
+  int cols = static_cast<int>(canvas.cols());
+  const int width = canvas.cellBytes();
+  const uint32_t *colors = canvas.colors();
+  const uint8_t *lut = _trueColor ? nullptr : palette();
+  auto map = [&](uint32_t color) -> uint32_t {
+    if (color == COLOR_DEFAULT || lut == nullptr) {
+      return color;
+    }
+    const int drop = 8 - PALETTE_BITS;
+    uint32_t r = (color >> 16 & 0xFF) >> drop, g = (color >> 8 & 0xFF) >> drop, b = (color & 0xFF) >> drop;
+    return lut[(r << PALETTE_BITS | g) << PALETTE_BITS | b];
+  };
+
+  _colors.resize(static_cast<size_t>(rows) * cols);
+  for (int i = 0; i < rows; i++) {
+    const char *row = canvas.data() + static_cast<size_t>(i) * canvas.stride();
+    for (int j = 0; j < cols; j++) {
+      size_t cell = static_cast<size_t>(i) * cols + j;
+      const char *glyph = row + j * width;
+      bool blank = width == 1 ? *glyph == ' ' : std::memcmp(glyph, CELL_UTF8_BLANK, width) == 0;
+      uint32_t fg = blank ? COLOR_DEFAULT : map(colors[2 * cell]);
+      _colors[cell] = static_cast<uint64_t>(fg) << 32 | map(colors[2 * cell + 1]);
+    }
+  }
+}
+
+// Appends the escape switching the terminal to the given colours, if they differ
+void FrameEncoder::setColors(uint64_t colors) {
+  if (colors == _sgr) {
+    return;
+  }
+  // One escape sets whichever of the two changed
+  auto append = [&](uint32_t color, const char *base, const char *reset) {
+    if (color == COLOR_DEFAULT) {
+      _frame += reset;
+    } else if (_trueColor) {
+      _frame += base;
+      _frame += "2;" + std::to_string(color >> 16 & 0xFF) + ";" + std::to_string(color >> 8 & 0xFF) + ";" +
+                std::to_string(color & 0xFF);
+    } else {
+      _frame += base;
+      _frame += "5;" + std::to_string(color);
+    }
+  };
+  uint32_t fg = static_cast<uint32_t>(colors >> 32), bg = static_cast<uint32_t>(colors);
+  bool fgChanged = fg != static_cast<uint32_t>(_sgr >> 32), bgChanged = bg != static_cast<uint32_t>(_sgr);
+  _frame += "\033[";
+  if (fgChanged) {
+    append(fg, "38;", "39");
+  }
+  if (bgChanged) {
+    if (fgChanged) {
+      _frame += ';';
+    }
+    append(bg, "48;", "49");
+  }
+  _frame += 'm';
+  _sgr = colors;
+}
+
+// Appends a run of coloured cells
+void FrameEncoder::appendColored(const Canvas &canvas, int row, int start, int end) {
+  const int width = canvas.cellBytes();
+  const char *cells = canvas.data() + static_cast<size_t>(row) * canvas.stride();
+  const uint64_t *colors = &_colors[static_cast<size_t>(row) * static_cast<int>(canvas.cols())];
+  for (int j = start; j < end; j++) {
+    uint64_t target = colors[j];
+    if (static_cast<uint32_t>(target >> 32) == COLOR_DEFAULT) {
+      // Blank cells show no foreground, so whatever is set can stay
+      target = (_sgr & 0xFFFFFFFF00000000ull) | (target & 0xFFFFFFFFull);
+    }
+    setColors(target);
+    _frame.append(cells + j * width, width);
+  }
+}
+
+// Retrieves the palette entry closest to every colour
+const uint8_t *FrameEncoder::palette() {
+  static const std::vector<uint8_t> lut = [] {
+    // Entries 16 to 231 are a 6x6x6 colour cube, 232 to 255 a ramp of greys
+    const int levels[6] = {0, 95, 135, 175, 215, 255};
+    const int size = 1 << PALETTE_BITS;
+    std::vector<uint8_t> table(size * size * size);
+    for (int index = 0; index < size * size * size; index++) {
+      int rgb[3], cube[3], dist = 0, sum = 0;
+      for (int c = 0; c < 3; c++) {
+        // The centre of the colours sharing this entry
+        rgb[c] = (index >> (PALETTE_BITS * (2 - c)) & (size - 1)) << (8 - PALETTE_BITS) | 1 << (7 - PALETTE_BITS);
+        cube[c] = 0;
+        for (int l = 1; l < 6; l++) {
+          if (std::abs(levels[l] - rgb[c]) < std::abs(levels[cube[c]] - rgb[c])) {
+            cube[c] = l;
+          }
+        }
+        dist += (levels[cube[c]] - rgb[c]) * (levels[cube[c]] - rgb[c]);
+        sum += rgb[c];
+      }
+      int grey = std::min(std::max((sum / 3 - 8 + 5) / 10, 0), 23);
+      int greyDist = 0;
+      for (int c = 0; c < 3; c++) {
+        greyDist += (8 + 10 * grey - rgb[c]) * (8 + 10 * grey - rgb[c]);
+      }
+      table[index] = static_cast<uint8_t>(greyDist < dist ? 232 + grey : 16 + 36 * cube[0] + 6 * cube[1] + cube[2]);
+    }
+    return table;
+  }();
+  return lut.data();
+}
+
+// Appends the shortest escape moving the cursor to a cell
+void FrameEncoder::moveTo(int row, int col) {
+  if (row == _cursorRow) {
+    // Same row: step forward over the unchanged cells
+    _frame += "\033[" + std::to_string(col - _cursorCol) + "C";
+  } else {
+    _frame += "\033[" + std::to_string(row + 1) + ";" + std::to_string(col + 1) + "H";
+  }
+  _cursorRow = row;
+  _cursorCol = col;
+}
+
+// Returns the number of bytes of the last encoded frame
+size_t FrameEncoder::size() const {
+  return _frame.size() + _bodySize;
+}
+
+// Writes the last encoded frame with a single writev()
+bool FrameEncoder::write(int fd) {
+  struct iovec parts[2] = {{const_cast<char *>(_frame.data()), _frame.size()},
+                           {const_cast<char *>(_body), _bodySize}};
+  int first = 0;
+  while (first < 2) {
+    ssize_t written = writev(fd, parts + first, 2 - first);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      _valid = false;  // The screen is in an unknown state
+      return false;
+    }
+    // A slow terminal may take only part of the frame
+    while (first < 2 && static_cast<size_t>(written) >= parts[first].iov_len) {
+      written -= parts[first].iov_len;
+      first++;
+    }
+    if (first < 2) {
+      parts[first].iov_base = static_cast<char *>(parts[first].iov_base) + written;
+      parts[first].iov_len -= written;
+    }
+  }
+  return true;
+}
+
+// Forgets what is on screen, so the next frame clears it and redraws in full
+void FrameEncoder::invalidate() {
+  _valid = false;
+}
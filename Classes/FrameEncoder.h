@@ -0,0 +1,121 @@
+#ifndef _FRAME_ENCODER_H_
+#define _FRAME_ENCODER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Canvas.h"
+
+#define DIFF_GAP 4  // Unchanged bytes shorter than a cursor escape are rewritten rather than skipped
+#define PALETTE_BITS 5  // Bits kept of every channel when looking a colour up in the 256-colour palette
+#define SGR_MAX 36      // Bytes of the longest colour escape, both colours set in 24 bits
+
+/**
+ * @brief Turns canvases into the bytes that update a terminal from one frame to the next.
+ * The encoder remembers the canvas currently on screen and emits only the
+ * runs of cells that changed, each preceded by a cursor movement. When that
+ * would take more bytes than redrawing everything, or when nothing is known
+ * about the screen, it redraws the whole canvas instead, sending the
+ * canvas's own buffer without copying it.
+ *
+ * Coloured canvases are interleaved with SGR escapes. Colours are first
+ * mapped to what the terminal will show, through a lookup table for the
+ * 256-colour palette, so runs of equal colours share one escape and only
+ * colour changes the terminal can see count as changed cells.
+ *
+ * Whenever the layout changes, the frame buffer is reserved up to the
+ * largest frame the layout can produce, so encoding never allocates.
+ */
+class FrameEncoder {
+ private:
+  Canvas _previous{0, 0};         ///< Canvas currently on the terminal
+  bool _valid = false;            ///< Whether _previous matches the terminal
+  std::string _frame;             ///< Escapes and changed runs of the last frame, reused from frame to frame
+  const char *_body = nullptr;    ///< Canvas bytes sent after _frame by a full redraw
+  size_t _bodySize = 0;           ///< Length of _body
+  int _cursorRow = 0;             ///< Row of the cursor while encoding
+  int _cursorCol = 0;             ///< Column of the cursor while encoding
+  bool _trueColor = false;        ///< Whether the frame being encoded uses 24-bit colours
+  uint64_t _sgr = 0;              ///< Foreground and background the terminal draws with while encoding
+  std::vector<uint64_t> _colors;  ///< Terminal foreground and background of every cell being encoded
+  std::vector<uint64_t> _previousColors; ///< Terminal foreground and background of every cell on screen
+
+  /**
+   * @brief Maps the colours of every cell to the ones the terminal will show.
+   * The foreground of a blank cell cannot be seen, so it is left out.
+   * @param canvas The canvas to encode.
+   */
+  void mapColors(const Canvas &canvas);
+
+  /**
+   * @brief Appends the escape switching the terminal to the given colours, if they differ.
+   * @param colors The foreground in the high half and the background in the low half.
+   */
+  void setColors(uint64_t colors);
+
+  /**
+   * @brief Appends a run of coloured cells.
+   * @param canvas The canvas to encode.
+   * @param row The row of the cells.
+   * @param start The first column of the run.
+   * @param end One past the last column of the run.
+   */
+  void appendColored(const Canvas &canvas, int row, int start, int end);
+
+  /**
+   * @brief Encodes the whole canvas, homing the cursor first.
+   * @param canvas The canvas to draw.
+   */
+  void encodeFull(const Canvas &canvas);
+
+  /**
+   * @brief Counts the bytes encodeFull() would take for a coloured canvas, escapes included.
+   * @param canvas The canvas to encode, its colours already mapped.
+   * @return The size of the full redraw.
+   */
+  size_t coloredFullSize(const Canvas &canvas) const;
+
+  /**
+   * @brief Retrieves the palette entry closest to every colour.
+   * @return The 256-colour index of every colour with PALETTE_BITS per channel.
+   */
+  static const uint8_t *palette();
+
+  /**
+   * @brief Appends the shortest escape moving the cursor to a cell.
+   * @param row The row of the cell.
+   * @param col The column of the cell.
+   */
+  void moveTo(int row, int col);
+
+ public:
+  /**
+   * @brief Encodes the update from the canvas on screen to a new one.
+   * The encoder keeps the new canvas's buffer as the screen's contents and
+   * hands its previous buffer back through `canvas`, so frames are not
+   * copied; the caller draws the next frame over it. Only the first frame
+   * of a new size is copied, and `canvas` is then left as it was.
+   * @param canvas The new canvas; receives the previously displayed one.
+   */
+  void encode(Canvas &canvas);
+
+  /**
+   * @brief Returns the number of bytes of the last encoded frame.
+   * @return The size of the frame.
+   */
+  size_t size() const;
+
+  /**
+   * @brief Writes the last encoded frame with a single writev().
+   * @param fd The file descriptor of the terminal.
+   * @return True if every byte was written.
+   */
+  bool write(int fd);
+
+  /**
+   * @brief Forgets what is on screen, so the next frame clears it and redraws in full.
+   */
+  void invalidate();
+};
+
+#endif //_FRAME_ENCODER_H_
@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <cmath>
+#include "GlyphPacker.h"
+#include "Simd.h"
+
+// 4x4 ordered dither matrix; sample (I, J) is lit above (BAYER[I & 3][J & 3] + 0.5) / 16
+static const int BAYER[4][4] = {{0, 8, 2, 10}, {12, 4, 14, 6}, {3, 11, 1, 9}, {15, 7, 13, 5}};
+
+// Writes the UTF-8 encoding of a code point between U+0800 and U+FFFF
+static void encodeUTF8(unsigned int code, char *out) {
+  out[0] = static_cast<char>(0xE0 | (code >> 12));
+  out[1] = static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+  out[2] = static_cast<char>(0x80 | (code & 0x3F));
+}
+
+// Constructs a packer for a glyph mode and builds its glyph table
+GlyphPacker::GlyphPacker(GlyphMode mode) {
+  for (int l = 0; l < SHADE_LEVELS; l++) {
+    _ramp[l] = 0;
+    for (int shift = 0; shift < 24; shift += 8) {
+      double dark = SHADE_DARK >> shift & 0xFF, light = SHADE_LIGHT >> shift & 0xFF;
+      _ramp[l] |= static_cast<uint32_t>(std::lround(dark + (light - dark) * l / (SHADE_LEVELS - 1))) << shift;
+    }
+  }
+
+  switch (mode) {
+    case GlyphMode::Ascii:
+      _subRows = 1;
+      _subCols = 1;
+      return;
+    case GlyphMode::HalfBlock:
+      _subRows = 2;
+      _subCols = 1;
+      break;
+    case GlyphMode::Braille:
+      _subRows = 4;
+      _subCols = 2;
+      break;
+  }
+
+  // Bit r * _subCols + s of a mask is the sample at row r and column s of the cell
+  unsigned int masks = 1u << (_subRows * _subCols);
+  _glyphs.resize(masks * CELL_UTF8);
+  for (unsigned int mask = 0; mask < masks; mask++) {
+    unsigned int code;
+    if (mode == GlyphMode::HalfBlock) {
+      const unsigned int halves[4] = {0x2800, 0x2580, 0x2584, 0x2588};  // Blank, upper, lower, full
+      code = halves[mask];
+    } else {
+      // Braille numbers the dots down the left column, then the right, with the bottom row last
+      code = 0x2800;
+      for (int r = 0; r < 4; r++) {
+        for (int s = 0; s < 2; s++) {
+          if (mask >> (r * 2 + s) & 1) {
+            code |= 1u << (r < 3 ? s * 3 + r : 6 + s);
+          }
+        }
+      }
+    }
+    encodeUTF8(code, &_glyphs[mask * CELL_UTF8]);
+  }
+}
+
+// Returns the number of sample rows in every cell
+int GlyphPacker::subRows() const {
+  return _subRows;
+}
+
+// Returns the number of sample columns in every cell
+int GlyphPacker::subCols() const {
+  return _subCols;
+}
+
+// Looks up the colour of a brightness in the shading ramp
+uint32_t GlyphPacker::shadeColor(double level) const {
+  int l = static_cast<int>(level * SHADE_LEVELS);
+  return _ramp[level >= 0 ? std::min(l, SHADE_LEVELS - 1) : 0];
+}
+
+// Draws the glyph of every cell from its samples
+void GlyphPacker::pack(const float *shades, int stride, float darkest, float range, Canvas &canvas) {
+  const bool colored = canvas.colors() != nullptr;
+  if (colored && _subRows == 2 && _subCols == 1) {
+    packColoredHalves(shades, stride, darkest, range, canvas);
+    return;
+  }
+
+  int rows = std::max(0, static_cast<int>(canvas.rows()));
+  int cols = std::max(0, static_cast<int>(canvas.cols()));
+  int samples = cols * _subCols;
+  int padded = (samples + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+  int words = (padded + 31) / 32;
+  _lit.resize(static_cast<size_t>(_subRows) * words);
+
+  // The lowest lit brightness, repeated across a vector for every row of the dither matrix
+  float cuts[4][SIMD_WIDTH];
+  for (int y = 0; y < 4; y++) {
+    for (int l = 0; l < SIMD_WIDTH; l++) {
+      float threshold = (BAYER[y][l & 3] + 0.5f) / 16;
+      float coverage = (threshold - GLYPH_MIN_COVERAGE) / (1 - GLYPH_MIN_COVERAGE);
+      cuts[y][l] = range >= 0 ? static_cast<float>(darkest + range * coverage) : INFINITY;
+    }
+  }
+
+  for (int i = 0; i < rows; i++) {
+    for (int r = 0; r < _subRows; r++) {
+      int row = i * _subRows + r;
+      const float *src = shades + static_cast<size_t>(row) * stride;  // Its padding is never lit
+
+      // SIMD_WIDTH divides 32, so a vector's bits never straddle two words
+      uint32_t *lit = &_lit[static_cast<size_t>(r) * words];
+      std::fill(lit, lit + words, 0);
+      floatv cut = load(cuts[row & 3]);
+      for (int j = 0; j < padded; j += SIMD_WIDTH) {
+        lit[j / 32] |= static_cast<uint32_t>(bits(load(src + j) >= cut)) << (j % 32);
+      }
+    }
+
+    // _subCols divides 32 as well, so a cell's samples sit in one word
+    const uint32_t cellBits = (1u << _subCols) - 1;
+    for (int j = 0; j < cols; j++) {
+      int bit = j * _subCols;
+      unsigned int mask = 0;
+      for (int r = 0; r < _subRows; r++) {
+        mask |= (_lit[static_cast<size_t>(r) * words + bit / 32] >> (bit % 32) & cellBits) << (r * _subCols);
+      }
+      canvas.draw(&_glyphs[mask * CELL_UTF8], i, j);
+
+      if (colored) {
+        // The dots take the colour of the cell's average brightness
+        float sum = 0;
+        int hits = 0;
+        for (int r = 0; r < _subRows; r++) {
+          const float *src = shades + static_cast<size_t>(i * _subRows + r) * stride + bit;
+          for (int s = 0; s < _subCols; s++) {
+            if (src[s] != -INFINITY) {
+              sum += src[s];
+              hits++;
+            }
+          }
+        }
+        uint32_t fg = hits > 0 ? shadeColor(range > 0 ? (sum / hits - darkest) / range : 1) : COLOR_DEFAULT;
+        canvas.setColor(i, j, fg, COLOR_DEFAULT);
+      }
+    }
+  }
+}
+
+// Draws every cell as a half block coloured by its two samples
+void GlyphPacker::packColoredHalves(const float *shades, int stride, float darkest, float range,
+                                    Canvas &canvas) {
+  int rows = std::max(0, static_cast<int>(canvas.rows()));
+  int cols = std::max(0, static_cast<int>(canvas.cols()));
+  auto color = [&](float shine) { return shadeColor(range > 0 ? (shine - darkest) / range : 1); };
+
+  for (int i = 0; i < rows; i++) {
+    const float *top = shades + static_cast<size_t>(2 * i) * stride;
+    const float *bottom = top + stride;
+    for (int j = 0; j < cols; j++) {
+      // Mask bit 0 is the upper half and bit 1 the lower one
+      unsigned int mask = (top[j] != -INFINITY) | (bottom[j] != -INFINITY) << 1;
+      uint32_t fg = COLOR_DEFAULT, bg = COLOR_DEFAULT;
+      if (mask == 1) {
+        fg = color(top[j]);
+      } else if (mask == 2) {
+        fg = color(bottom[j]);
+      } else if (mask == 3) {
+        fg = color(top[j]);
+        bg = color(bottom[j]);
+        if (fg == bg) {
+          bg = COLOR_DEFAULT;  // A full block needs no background, sparing an escape
+        } else {
+          mask = 1;  // The upper half in the foreground over the lower one in the background
+        }
+      }
+      canvas.draw(&_glyphs[mask * CELL_UTF8], i, j);
+      canvas.setColor(i, j, fg, bg);
+    }
+  }
+}
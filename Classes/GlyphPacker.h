@@ -0,0 +1,90 @@
+#ifndef _GLYPH_PACKER_H_
+#define _GLYPH_PACKER_H_
+
+#include <cstdint>
+#include <vector>
+#include "Canvas.h"
+
+#define GLYPH_MIN_COVERAGE 0.125f  // Share of dots lit on the darkest surface, so it stands out from empty space
+#define SHADE_LEVELS 16            // Colours in the shading ramp, few enough for neighbouring cells to share one
+#define SHADE_DARK 0x2A3450u       // Colour of the darkest lit surface
+#define SHADE_LIGHT 0xFFF2D8u      // Colour of the brightest lit surface
+
+/**
+ * @brief How the samples traced for a cell turn into the character drawn there.
+ */
+enum class GlyphMode {
+  Ascii,      ///< One sample per cell, drawn with the ASCII brightness ramp
+  HalfBlock,  ///< 1x2 samples per cell, drawn with the upper and lower half blocks
+  Braille     ///< 2x4 samples per cell, drawn with Braille patterns
+};
+
+/**
+ * @brief Packs sub-cell samples into Unicode glyphs.
+ * Every sample becomes a lit or dark dot by comparing its brightness with a
+ * 4x4 ordered dither threshold, so shading survives as dot density. The dots
+ * of a cell form a bit mask that indexes a table of UTF-8 glyphs built once
+ * per mode. The comparison runs a whole vector of samples at a time.
+ *
+ * On a coloured canvas the shading also goes into the colours, taken from a
+ * ramp of SHADE_LEVELS steps. Half blocks then draw their two samples as the
+ * foreground and background colours instead of dithering them.
+ */
+class GlyphPacker {
+ private:
+  int _subRows;                 ///< Sample rows in every cell
+  int _subCols;                 ///< Sample columns in every cell
+  std::vector<char> _glyphs;    ///< CELL_UTF8 bytes of the glyph for every dot mask
+  std::vector<uint32_t> _lit;   ///< Lit samples of the rows of one cell row, one bit each
+  uint32_t _ramp[SHADE_LEVELS]; ///< Colours of the shading ramp, darkest first
+
+  /**
+   * @brief Draws every cell as a half block coloured by its two samples.
+   * @param shades Brightness of every sample, -INFINITY where nothing was hit.
+   * @param stride The distance between two rows of samples in shades.
+   * @param darkest The lowest brightness of any sample that hit.
+   * @param range The brightest sample minus the darkest one.
+   * @param canvas The coloured canvas receiving the glyphs.
+   */
+  void packColoredHalves(const float *shades, int stride, float darkest, float range, Canvas &canvas);
+
+ public:
+  /**
+   * @brief Constructs a packer for a glyph mode and builds its glyph table.
+   * @param mode The glyph mode; Ascii only defines the one-sample layout.
+   */
+  explicit GlyphPacker(GlyphMode mode);
+
+  /**
+   * @brief Returns the number of sample rows in every cell.
+   * @return The sample rows per cell.
+   */
+  int subRows() const;
+
+  /**
+   * @brief Returns the number of sample columns in every cell.
+   * @return The sample columns per cell.
+   */
+  int subCols() const;
+
+  /**
+   * @brief Looks up the colour of a brightness in the shading ramp.
+   * @param level The brightness, 0 for the darkest surface and 1 for the brightest.
+   * @return The colour as 0xRRGGBB.
+   */
+  uint32_t shadeColor(double level) const;
+
+  /**
+   * @brief Draws the glyph of every cell from its samples.
+   * @param shades Brightness of every sample, -INFINITY where nothing was hit, with every
+   *               row padded by misses to a whole number of SIMD vectors.
+   * @param stride The distance between two rows of samples in shades.
+   * @param darkest The lowest brightness of any sample that hit.
+   * @param range The brightest sample minus the darkest one.
+   * @param canvas The canvas receiving the glyphs, with CELL_UTF8 bytes per cell; also
+   *               receives their colours if it has any.
+   */
+  void pack(const float *shades, int stride, float darkest, float range, Canvas &canvas);
+};
+
+#endif //_GLYPH_PACKER_H_
@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include "GlyphRamp.h"
+
+// Printable ASCII rasterized from DejaVu Sans Mono into 8x16 cells, one byte per row with the leftmost pixel on top
+static const unsigned char FONT[FONT_GLYPHS][FONT_ROWS] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},  // space
+    {0x00, 0x00, 0x00, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00},  // !
+    {0x00, 0x00, 0x00, 0x24, 0x24, 0x24, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},  // "
+    {0x00, 0x00, 0x00, 0x12, 0x12, 0x16, 0x7F, 0x24, 0x24, 0xFE, 0x28, 0x48, 0x48, 0x00, 0x00, 0x00},  // #
+    {0x00, 0x00, 0x00, 0x08, 0x3E, 0x68, 0x48, 0x38, 0x1C, 0x0A, 0x0A, 0x4E, 0x3C, 0x08, 0x00, 0x00},  // $
+    {0x00, 0x00, 0x00, 0x60, 0x90, 0x90, 0x70, 0x0C, 0x34, 0x0A, 0x09, 0x0B, 0x06, 0x00, 0x00, 0x00},  // %
+    {0x00, 0x00, 0x00, 0x3C, 0x20, 0x20, 0x20, 0x70, 0x59, 0xCD, 0xC6, 0x46, 0x3B, 0x00, 0x00, 0x00},  // &
+    {0x00, 0x00, 0x00, 0x18, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},  // quote
+    {0x00, 0x00, 0x00, 0x08, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x08, 0x08, 0x00, 0x00},  // (
+    {0x00, 0x00, 0x00, 0x10, 0x10, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x10, 0x10, 0x00, 0x00},  // )
+    {0x00, 0x00, 0x00, 0x00, 0x66, 0x18, 0x3C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},  // *
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x18, 0xFF, 0x18, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00},  // +
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x10, 0x10, 0x00},  // ,
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},  // -
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00},  // .
+    {0x00, 0x00, 0x00, 0x06, 0x04, 0x0C, 0x08, 0x08, 0x10, 0x10, 0x30, 0x20, 0x60, 0x40, 0x00, 0x00},  // /
+    {0x00, 0x00, 0x00, 0x3C, 0x66, 0x42, 0x42, 0x5A, 0x42, 0x42, 0x66, 0x24, 0x3C, 0x00, 0x00, 0x00},  // 0
+    {0x00, 0x00, 0x00, 0x38, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x3E, 0x00, 0x00, 0x00},  // 1
+    {0x00, 0x00, 0x00, 0x7C, 0x06, 0x06, 0x06, 0x04, 0x08, 0x10, 0x20, 0x60, 0x7E, 0x00, 0x00, 0x00},  // 2
+    {0x00, 0x00, 0x00, 0x7C, 0x06, 0x06, 0x04, 0x3C, 0x06, 0x02, 0x02, 0x46, 0x7C, 0x00, 0x00, 0x00},  // 3
+    {0x00, 0x00, 0x00, 0x0C, 0x1C, 0x14, 0x24, 0x24, 0x44, 0x7E, 0x04, 0x04, 0x04, 0x00, 0x00, 0x00},  // 4
+    {0x00, 0x00, 0x00, 0x7C, 0x60, 0x60, 0x78, 0x0C, 0x06, 0x02, 0x06, 0x44, 0x78, 0x00, 0x00, 0x00},  // 5
+    {0x00, 0x00, 0x08, 0x3E, 0x60, 0x40, 0x5C, 0x66, 0x42, 0x42, 0x42, 0x26, 0x3C, 0x00, 0x00, 0x00},  // 6
+    {0x00, 0x00, 0x00, 0x7E, 0x06, 0x04, 0x04, 0x08, 0x08, 0x18, 0x10, 0x10, 0x30, 0x00, 0x00, 0x00},  // 7
+    {0x00, 0x00, 0x00, 0x3C, 0x66, 0x42, 0x66, 0x3C, 0x66, 0x42, 0x42, 0x66, 0x3C, 0x00, 0x00, 0x00},  // 8
+    {0x00, 0x00, 0x00, 0x3C, 0x46, 0x42, 0x42, 0x46, 0x3E, 0x02, 0x06, 0x0C, 0x38, 0x00, 0x00, 0x00},  // 9
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00},  // :
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x18, 0x18, 0x10, 0x10, 0x00},  // ;
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x0E, 0x70, 0xE0, 0x38, 0x0E, 0x00, 0x00, 0x00, 0x00, 0x00},  // <
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7E, 0x7E, 0x00, 0x7E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},  // =
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x70, 0x0E, 0x07, 0x1C, 0x70, 0x00, 0x00, 0x00, 0x00, 0x00},  // >
+    {0x00, 0x00, 0x00, 0x3C, 0x06, 0x06, 0x04, 0x08, 0x18, 0x18, 0x00, 0x18, 0x10, 0x00, 0x00, 0x00},  // ?
+    {0x00, 0x00, 0x00, 0x08, 0x36, 0x42, 0x4F, 0x93, 0x91, 0x91, 0x93, 0x4F, 0x40, 0x20, 0x1E, 0x00},  // @
+    {0x00, 0x00, 0x00, 0x18, 0x18, 0x3C, 0x24, 0x24, 0x66, 0x7E, 0x42, 0x42, 0xC3, 0x00, 0x00, 0x00},  // A
+    {0x00, 0x00, 0x00, 0x7C, 0x46, 0x42, 0x46, 0x7C, 0x42, 0x42, 0x42, 0x66, 0x7C, 0x00, 0x00, 0x00},  // B
+    {0x00, 0x00, 0x00, 0x3E, 0x20, 0x60, 0x40, 0x40, 0x40, 0x40, 0x60, 0x32, 0x1E, 0x00, 0x00, 0x00},  // C
+    {0x00, 0x00, 0x00, 0x7C, 0x44, 0x42, 0x42, 0x42, 0x42, 0x42, 0x46, 0x4C, 0x78, 0x00, 0x00, 0x00},  // D
+    {0x00, 0x00, 0x00, 0x7E, 0x60, 0x60, 0x60, 0x7E, 0x60, 0x60, 0x60, 0x60, 0x7E, 0x00, 0x00, 0x00},  // E
+    {0x00, 0x00, 0x00, 0x7E, 0x60, 0x60, 0x60, 0x7E, 0x60, 0x60, 0x60, 0x60, 0x20, 0x00, 0x00, 0x00},  // F
+    {0x00, 0x00, 0x00, 0x3E, 0x60, 0x40, 0x40, 0x40, 0x46, 0x42, 0x62, 0x22, 0x1C, 0x00, 0x00, 0x00},  // G
+    {0x00, 0x00, 0x00, 0x42, 0x42, 0x42, 0x42, 0x7E, 0x42, 0x42, 0x42, 0x42, 0x42, 0x00, 0x00, 0x00},  // H
+    {0x00, 0x00, 0x00, 0x7E, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x7E, 0x00, 0x00, 0x00},  // I
+    {0x00, 0x00, 0x00, 0x1C, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x4C, 0x78, 0x00, 0x00, 0x00},  // J
+    {0x00, 0x00, 0x00, 0x42, 0x44, 0x48, 0x50, 0x78, 0x68, 0x4C, 0x44, 0x42, 0x43, 0x00, 0x00, 0x00},  // K
+    {0x00, 0x00, 0x00, 0x60, 0x60, 0x60, 0x60, 0x60, 0x60, 0x60, 0x60, 0x60, 0x7E, 0x00, 0x00, 0x00},  // L
+    {0x00, 0x00, 0x00, 0xE7, 0xE7, 0xE7, 0xDB, 0xDB, 0xDB, 0xC3, 0xC3, 0xC3, 0x42, 0x00, 0x00, 0x00},  // M
+    {0x00, 0x00, 0x00, 0x62, 0x62, 0x72, 0x52, 0x52, 0x4A, 0x4A, 0x46, 0x46, 0x46, 0x00, 0x00, 0x00},  // N
+    {0x00, 0x00, 0x00, 0x3C, 0x66, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x66, 0x3C, 0x00, 0x00, 0x00},  // O
+    {0x00, 0x00, 0x00, 0x7E, 0x62, 0x62, 0x62, 0x66, 0x7C, 0x60, 0x60, 0x60, 0x60, 0x00, 0x00, 0x00},  // P
+    {0x00, 0x00, 0x00, 0x3C, 0x66, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x66, 0x3C, 0x04, 0x00, 0x00},  // Q
+    {0x00, 0x00, 0x00, 0x7C, 0x46, 0x46, 0x46, 0x7C, 0x7C, 0x44, 0x42, 0x42, 0x41, 0x00, 0x00, 0x00},  // R
+    {0x00, 0x00, 0x00, 0x3E, 0x40, 0x40, 0x60, 0x3C, 0x06, 0x02, 0x02, 0x46, 0x7C, 0x00, 0x00, 0x00},  // S
+    {0x00, 0x00, 0x00, 0xFF, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x00, 0x00, 0x00},  // T
+    {0x00, 0x00, 0x00, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x66, 0x3C, 0x00, 0x00, 0x00},  // U
+    {0x00, 0x00, 0x00, 0x42, 0x42, 0x42, 0x66, 0x24, 0x24, 0x24, 0x18, 0x18, 0x18, 0x00, 0x00, 0x00},  // V
+    {0x00, 0x00, 0x00, 0x81, 0xC3, 0xC3, 0x5A, 0x5A, 0x5A, 0x66, 0x66, 0x66, 0x66, 0x00, 0x00, 0x00},  // W
+    {0x00, 0x00, 0x00, 0x42, 0x26, 0x34, 0x18, 0x18, 0x18, 0x24, 0x66, 0x42, 0xC3, 0x00, 0x00, 0x00},  // X
+    {0x00, 0x00, 0x00, 0x42, 0x66, 0x24, 0x3C, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x00, 0x00, 0x00},  // Y
+    {0x00, 0x00, 0x00, 0x7E, 0x02, 0x04, 0x0C, 0x08, 0x10, 0x30, 0x20, 0x60, 0x7F, 0x00, 0x00, 0x00},  // Z
+    {0x00, 0x00, 0x1C, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x18, 0x00},  // [
+    {0x00, 0x00, 0x00, 0x40, 0x60, 0x20, 0x30, 0x10, 0x18, 0x08, 0x08, 0x04, 0x04, 0x06, 0x00, 0x00},  // backslash
+    {0x00, 0x00, 0x38, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x18, 0x00},  // ]
+    {0x00, 0x00, 0x00, 0x18, 0x24, 0x66, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},  // ^
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF},  // _
+    {0x00, 0x00, 0x30, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},  // `
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x3C, 0x06, 0x02, 0x3E, 0x62, 0x46, 0x46, 0x3A, 0x00, 0x00, 0x00},  // a
+    {0x00, 0x00, 0x00, 0x60, 0x60, 0x7C, 0x66, 0x62, 0x62, 0x62, 0x62, 0x66, 0x7C, 0x00, 0x00, 0x00},  // b
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x1E, 0x30, 0x60, 0x60, 0x60, 0x60, 0x30, 0x1E, 0x00, 0x00, 0x00},  // c
+    {0x00, 0x00, 0x02, 0x06, 0x06, 0x3E, 0x66, 0x46, 0x46, 0x46, 0x46, 0x66, 0x3E, 0x00, 0x00, 0x00},  // d
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x1C, 0x66, 0x42, 0x7E, 0x40, 0x40, 0x62, 0x1E, 0x00, 0x00, 0x00},  // e
+    {0x00, 0x00, 0x0E, 0x18, 0x10, 0x7E, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x00, 0x00, 0x00},  // f
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x3A, 0x66, 0x46, 0x46, 0x46, 0x46, 0x66, 0x3E, 0x06, 0x24, 0x38},  // g
+    {0x00, 0x00, 0x00, 0x60, 0x60, 0x7C, 0x66, 0x62, 0x62, 0x62, 0x62, 0x62, 0x42, 0x00, 0x00, 0x00},  // h
+    {0x00, 0x00, 0x00, 0x08, 0x00, 0x38, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x7E, 0x00, 0x00, 0x00},  // i
+    {0x00, 0x00, 0x08, 0x08, 0x00, 0x38, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x38, 0x70},  // j
+    {0x00, 0x00, 0x20, 0x60, 0x60, 0x62, 0x64, 0x68, 0x78, 0x6C, 0x64, 0x66, 0x22, 0x00, 0x00, 0x00},  // k
+    {0x00, 0x00, 0x70, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x18, 0x0E, 0x00, 0x00, 0x00},  // l
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x76, 0x5A, 0x5A, 0x5A, 0x5A, 0x5A, 0x5A, 0x42, 0x00, 0x00, 0x00},  // m
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x7C, 0x66, 0x62, 0x62, 0x62, 0x62, 0x62, 0x42, 0x00, 0x00, 0x00},  // n
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x3C, 0x66, 0x42, 0x42, 0x42, 0x42, 0x66, 0x3C, 0x00, 0x00, 0x00},  // o
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x7C, 0x66, 0x62, 0x62, 0x62, 0x62, 0x66, 0x7C, 0x60, 0x60, 0x40},  // p
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x3A, 0x66, 0x46, 0x42, 0x42, 0x46, 0x66, 0x3E, 0x02, 0x02, 0x02},  // q
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x2E, 0x38, 0x30, 0x30, 0x30, 0x30, 0x30, 0x20, 0x00, 0x00, 0x00},  // r
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x3C, 0x20, 0x60, 0x38, 0x0C, 0x06, 0x06, 0x3C, 0x00, 0x00, 0x00},  // s
+    {0x00, 0x00, 0x00, 0x10, 0x10, 0x7E, 0x10, 0x10, 0x10, 0x10, 0x10, 0x18, 0x0E, 0x00, 0x00, 0x00},  // t
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x62, 0x62, 0x62, 0x62, 0x66, 0x66, 0x3A, 0x00, 0x00, 0x00},  // u
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x42, 0x42, 0x66, 0x24, 0x24, 0x3C, 0x18, 0x18, 0x00, 0x00, 0x00},  // v
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x81, 0x81, 0xC3, 0x5A, 0x5A, 0x66, 0x66, 0x24, 0x00, 0x00, 0x00},  // w
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x42, 0x24, 0x3C, 0x18, 0x18, 0x24, 0x66, 0x42, 0x00, 0x00, 0x00},  // x
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x42, 0x42, 0x26, 0x24, 0x34, 0x1C, 0x18, 0x18, 0x10, 0x30, 0x60},  // y
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x3E, 0x06, 0x0C, 0x08, 0x10, 0x30, 0x60, 0x7E, 0x00, 0x00, 0x00},  // z
+    {0x00, 0x00, 0x04, 0x08, 0x18, 0x18, 0x18, 0x18, 0x30, 0x10, 0x18, 0x18, 0x18, 0x08, 0x0E, 0x00},  // {
+    {0x00, 0x00, 0x00, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18},  // |
+    {0x00, 0x00, 0x20, 0x10, 0x18, 0x18, 0x18, 0x18, 0x0C, 0x08, 0x18, 0x18, 0x18, 0x10, 0x70, 0x00},  // }
+    {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x7E, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},  // ~
+};
+
+// Measures the font and builds the ramp and its table
+GlyphRamp::GlyphRamp() {
+  // Every glyph but the space, sparsest first; equal coverages keep the order of the codes
+  std::vector<std::pair<float, char>> glyphs;
+  for (int c = FONT_FIRST + 1; c < FONT_FIRST + FONT_GLYPHS; c++) {
+    glyphs.emplace_back(coverage(static_cast<char>(c)), static_cast<char>(c));
+  }
+  std::stable_sort(glyphs.begin(), glyphs.end(),
+                   [](const std::pair<float, char> &a, const std::pair<float, char> &b) { return a.first < b.first; });
+  // A glyph far denser than the rest would take a wide band of the brightest levels on its own
+  while (glyphs.size() > 2 && glyphs.back().first - glyphs[glyphs.size() - 2].first >
+                                  GLYPH_RAMP_MAX_GAP * (glyphs.back().first - glyphs.front().first) / GLYPH_RAMP_STEPS) {
+    glyphs.pop_back();
+  }
+  const float sparsest = glyphs.front().first, densest = glyphs.back().first;
+
+  // Index of the glyph whose coverage is closest to a target
+  auto nearest = [&](float target) {
+    auto above = std::lower_bound(glyphs.begin(), glyphs.end(), target,
+                                  [](const std::pair<float, char> &g, float t) { return g.first < t; });
+    if (above == glyphs.end() || (above != glyphs.begin() && target - (above - 1)->first <= above->first - target)) {
+      --above;
+    }
+    return above - glyphs.begin();
+  };
+
+  // The glyphs closest to evenly spaced coverages; a coverage already in the ramp adds nothing
+  std::vector<float> steps;
+  for (int s = 0; s < GLYPH_RAMP_STEPS; s++) {
+    const std::pair<float, char> &g = glyphs[nearest(sparsest + (densest - sparsest) * s / (GLYPH_RAMP_STEPS - 1))];
+    if (steps.empty() || g.first > steps.back()) {
+      _ramp.push_back(g.second);
+      steps.push_back(g.first);
+    }
+  }
+
+  // Every level takes the ramp glyph closest in coverage, so the table never steps back
+  size_t r = 0;
+  for (int level = 0; level < GLYPH_RAMP_LEVELS; level++) {
+    float target = sparsest + (densest - sparsest) * level / (GLYPH_RAMP_LEVELS - 1);
+    while (r + 1 < steps.size() && steps[r + 1] - target < target - steps[r]) {
+      r++;
+    }
+    _lut[level] = _ramp[r];
+  }
+}
+
+// Returns the ramp, built on first use
+const GlyphRamp &GlyphRamp::shared() {
+  static const GlyphRamp ramp;
+  return ramp;
+}
+
+// Returns the share of its cell a character covers in the embedded font
+float GlyphRamp::coverage(char c) {
+  int index = static_cast<unsigned char>(c) - FONT_FIRST;
+  if (index < 0 || index >= FONT_GLYPHS) {
+    return 0;
+  }
+  int lit = 0;
+  for (int row = 0; row < FONT_ROWS; row++) {
+    for (unsigned int bits = FONT[index][row]; bits != 0; bits &= bits - 1) {
+      lit++;
+    }
+  }
+  return lit / static_cast<float>(FONT_ROWS * 8);
+}
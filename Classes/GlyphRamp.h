@@ -0,0 +1,62 @@
+#ifndef _GLYPH_RAMP_H_
+#define _GLYPH_RAMP_H_
+
+#include <string>
+
+#define FONT_FIRST 32          // Character code of the first glyph in the embedded font
+#define FONT_GLYPHS 95         // Glyphs in the embedded font, every printable ASCII character
+#define FONT_ROWS 16           // Pixel rows of a glyph, each one byte with the leftmost pixel in the top bit
+#define GLYPH_RAMP_STEPS 32    // Most distinct glyphs in the ramp
+#define GLYPH_RAMP_MAX_GAP 2   // Widest coverage gap, in ramp steps, below the densest glyph kept
+#define GLYPH_RAMP_LEVELS 256  // Brightness levels looked up, the darkest first
+
+/**
+ * @brief Maps brightness to ASCII characters by how much of their cell they cover.
+ * The coverage of every printable character is measured once from an
+ * embedded 8x16 bitmap font. Glyphs nearest to evenly spaced coverages
+ * between the sparsest and the densest form the ramp, so equal steps of
+ * brightness look like equal steps of ink. The ramp is then compiled into
+ * a table of GLYPH_RAMP_LEVELS entries, making the character of a cell a
+ * single lookup. The space is left out, so a lit surface never looks like
+ * empty space, and a glyph much denser than all the others is left out too,
+ * so it does not take a band of the brightest levels on its own.
+ */
+class GlyphRamp {
+ private:
+  std::string _ramp;             ///< Glyphs of the ramp, sparsest first
+  char _lut[GLYPH_RAMP_LEVELS];  ///< Glyph of every brightness level
+
+  /**
+   * @brief Measures the font and builds the ramp and its table.
+   */
+  GlyphRamp();
+
+ public:
+  /**
+   * @brief Returns the ramp, built on first use.
+   * @return The ramp shared by every camera.
+   */
+  static const GlyphRamp &shared();
+
+  /**
+   * @brief Returns the share of its cell a character covers in the embedded font.
+   * @param c A printable ASCII character.
+   * @return The lit pixels over all pixels of the cell, or 0 if c is not in the font.
+   */
+  static float coverage(char c);
+
+  /**
+   * @brief Retrieves the glyphs of the ramp.
+   * @return The glyphs, sparsest first.
+   */
+  const std::string &ramp() const { return _ramp; }
+
+  /**
+   * @brief Looks up the glyph of a brightness level.
+   * @param level The level, from 0 for the darkest to GLYPH_RAMP_LEVELS - 1 for the brightest.
+   * @return The glyph to draw.
+   */
+  char glyph(int level) const { return _lut[level]; }
+};
+
+#endif //_GLYPH_RAMP_H_
@@ -0,0 +1,94 @@
+#include <atomic>
+#include "Grid.h"
+
+// Builds the grid over a set of primitives
+void Grid::build(const std::vector<Eigen::AlignedBox3d> &primBounds, ThreadPool &pool) {
+  _offsets.assign(1, 0);
+  _refs.clear();
+  unsigned int count = static_cast<unsigned int>(primBounds.size());
+  if (count == 0) {
+    return;
+  }
+  unsigned int chunks = (count + GRID_CHUNK - 1) / GRID_CHUNK;
+
+  // Bounds of everything, one partial box per task
+  std::vector<Eigen::AlignedBox3d> partial(chunks);
+  pool.parallelFor(chunks, [&](unsigned int c, unsigned int) {
+    partial[c].setEmpty();
+    for (unsigned int p = c * GRID_CHUNK; p < std::min(count, (c + 1) * GRID_CHUNK); p++) {
+      partial[c].extend(primBounds[p]);
+    }
+  });
+  _bounds.setEmpty();
+  for (const Eigen::AlignedBox3d &box : partial) {
+    _bounds.extend(box);
+  }
+
+  // Pad flat extents so every axis has a usable cell size
+  Eigen::Vector3d extent = _bounds.sizes();
+  double pad = std::max(extent.maxCoeff(), 1.0) * 1e-6;
+  _bounds.min().array() -= pad;
+  _bounds.max().array() += pad;
+  extent = _bounds.sizes();
+
+  // Aim for GRID_DENSITY cells per primitive, with cells as close to cubes as possible
+  double cellsPerUnit = std::cbrt(GRID_DENSITY * count / extent.prod());
+  for (int a = 0; a < 3; a++) {
+    _res[a] = std::min(std::max(static_cast<int>(std::round(extent[a] * cellsPerUnit)), 1), GRID_MAX_RES);
+  }
+  _cellSize = extent.cwiseQuotient(_res.cast<double>());
+  _invCellSize = _cellSize.cwiseInverse();
+  unsigned int cells = static_cast<unsigned int>(_res.prod());
+
+  // Count the references of every cell
+  std::vector<std::atomic<unsigned int>> counts(cells);
+  pool.parallelFor(chunks, [&](unsigned int c, unsigned int) {
+    for (unsigned int p = c * GRID_CHUNK; p < std::min(count, (c + 1) * GRID_CHUNK); p++) {
+      Eigen::Vector3i lo, hi;
+      cellRange(primBounds[p], lo, hi);
+      for (int z = lo.z(); z <= hi.z(); z++) {
+        for (int y = lo.y(); y <= hi.y(); y++) {
+          for (int x = lo.x(); x <= hi.x(); x++) {
+            counts[cellIndex(Eigen::Vector3i(x, y, z))].fetch_add(1, std::memory_order_relaxed);
+          }
+        }
+      }
+    }
+  });
+
+  // Turn the counts into offsets, leaving each count as its cell's write cursor
+  _offsets.resize(cells + 1);
+  unsigned int total = 0;
+  for (unsigned int i = 0; i < cells; i++) {
+    _offsets[i] = total;
+    total += counts[i].load(std::memory_order_relaxed);
+    counts[i].store(_offsets[i], std::memory_order_relaxed);
+  }
+  _offsets[cells] = total;
+
+  // Scatter the references into place
+  _refs.resize(total);
+  pool.parallelFor(chunks, [&](unsigned int c, unsigned int) {
+    for (unsigned int p = c * GRID_CHUNK; p < std::min(count, (c + 1) * GRID_CHUNK); p++) {
+      Eigen::Vector3i lo, hi;
+      cellRange(primBounds[p], lo, hi);
+      for (int z = lo.z(); z <= hi.z(); z++) {
+        for (int y = lo.y(); y <= hi.y(); y++) {
+          for (int x = lo.x(); x <= hi.x(); x++) {
+            _refs[counts[cellIndex(Eigen::Vector3i(x, y, z))].fetch_add(1, std::memory_order_relaxed)] = p;
+          }
+        }
+      }
+    }
+  });
+}
+
+// Retrieves the cells overlapped by a box
+void Grid::cellRange(const Eigen::AlignedBox3d &box, Eigen::Vector3i &lo, Eigen::Vector3i &hi) const {
+  for (int a = 0; a < 3; a++) {
+    int l = static_cast<int>((box.min()[a] - _bounds.min()[a]) * _invCellSize[a]);
+    int h = static_cast<int>((box.max()[a] - _bounds.min()[a]) * _invCellSize[a]);
+    lo[a] = std::min(std::max(l, 0), _res[a] - 1);
+    hi[a] = std::min(std::max(h, 0), _res[a] - 1);
+  }
+}
@@ -0,0 +1,143 @@
+#ifndef _GRID_H_
+#define _GRID_H_
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <Eigen/Dense>
+#include "ThreadPool.h"
+
+#define GRID_DENSITY 4     // Cells per primitive the resolution aims for
+#define GRID_MAX_RES 512   // Most cells along one axis
+#define GRID_MAILBOX 16    // Recently tested primitives remembered per ray, a power of two
+#define GRID_CHUNK 4096    // Primitives or cells handled by one build task
+
+/**
+ * @brief Uniform grid over a set of primitives, traversed with a 3D-DDA.
+ * Like the BVH, the grid only knows about primitive bounds and the owner
+ * supplies the actual primitive test during traversal. Rebuilding is a
+ * linear-time counting sort that runs on the thread pool, so it suits
+ * meshes that deform every frame.
+ */
+class Grid {
+ private:
+  Eigen::AlignedBox3d _bounds;        ///< Bounds of every primitive
+  Eigen::Vector3i _res;               ///< Cells along each axis
+  Eigen::Vector3d _cellSize;          ///< Size of a cell along each axis
+  Eigen::Vector3d _invCellSize;       ///< Cells per unit length along each axis
+  std::vector<unsigned int> _offsets; ///< Start of every cell in _refs, one past the end for the last
+  std::vector<unsigned int> _refs;    ///< Primitives overlapping each cell, cell by cell
+
+  /**
+   * @brief Retrieves the cells overlapped by a box.
+   * @param box The box, inside the grid bounds.
+   * @param lo Receives the first cell along each axis.
+   * @param hi Receives the last cell along each axis.
+   */
+  void cellRange(const Eigen::AlignedBox3d &box, Eigen::Vector3i &lo, Eigen::Vector3i &hi) const;
+
+  /**
+   * @brief Flattens a cell position into an index.
+   * @param cell The cell along each axis.
+   * @return The index of the cell.
+   */
+  unsigned int cellIndex(const Eigen::Vector3i &cell) const {
+    return (static_cast<unsigned int>(cell.z()) * _res.y() + cell.y()) * _res.x() + cell.x();
+  }
+
+ public:
+  /**
+   * @brief Builds the grid over a set of primitives.
+   * @param primBounds Bounds of every primitive.
+   * @param pool The threads sorting the primitives into cells.
+   */
+  void build(const std::vector<Eigen::AlignedBox3d> &primBounds, ThreadPool &pool);
+
+  /**
+   * @brief Walks the cells pierced by a ray in order and finds the closest hit.
+   * Every primitive is tested at most once per ray, even when it spans
+   * several cells, as long as it stays in the per-ray mailbox. Safe to call
+   * concurrently. The build scatters primitives from several threads, so
+   * a cell lists them in no particular order; a primTest wanting the same
+   * hit every time breaks ties between equal distances itself.
+   * @param orig The origin point of the ray.
+   * @param dir The direction of the ray.
+   * @param tMax The far end of the ray interval; shrunk to the closest hit found.
+   * @param primTest Called as primTest(prim, tMax); must return true and shrink tMax on a closer hit.
+   * @return True if any primitive was hit.
+   */
+  template <typename PrimTest>
+  bool intersect(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir, double &tMax, PrimTest &&primTest) const {
+    if (_refs.empty()) {
+      return false;
+    }
+
+    // Clip the ray to the grid
+    Eigen::Vector3d invDir = dir.cwiseInverse();
+    double tNear = 0, tFar = tMax;
+    for (int a = 0; a < 3; a++) {
+      double t0 = (_bounds.min()[a] - orig[a]) * invDir[a];
+      double t1 = (_bounds.max()[a] - orig[a]) * invDir[a];
+      if (t0 > t1) {
+        std::swap(t0, t1);
+      }
+      tNear = std::max(tNear, t0);
+      tFar = std::min(tFar, t1);
+    }
+    if (!(tNear <= tFar)) {
+      return false;
+    }
+
+    // Set up the 3D-DDA from the cell the ray enters
+    Eigen::Vector3d entry = orig + tNear * dir;
+    Eigen::Vector3i cell, step;
+    Eigen::Vector3d tNext, tDelta;
+    for (int a = 0; a < 3; a++) {
+      int c = static_cast<int>((entry[a] - _bounds.min()[a]) * _invCellSize[a]);
+      cell[a] = std::min(std::max(c, 0), _res[a] - 1);
+      if (dir[a] > 0) {
+        step[a] = 1;
+        tNext[a] = (_bounds.min()[a] + (cell[a] + 1) * _cellSize[a] - orig[a]) * invDir[a];
+        tDelta[a] = _cellSize[a] * invDir[a];
+      } else if (dir[a] < 0) {
+        step[a] = -1;
+        tNext[a] = (_bounds.min()[a] + cell[a] * _cellSize[a] - orig[a]) * invDir[a];
+        tDelta[a] = -_cellSize[a] * invDir[a];
+      } else {
+        step[a] = 0;
+        tNext[a] = INFINITY;
+        tDelta[a] = INFINITY;
+      }
+    }
+
+    unsigned int mailbox[GRID_MAILBOX];
+    std::fill(mailbox, mailbox + GRID_MAILBOX, ~0u);
+    bool hit = false;
+    while (true) {
+      unsigned int index = cellIndex(cell);
+      for (unsigned int r = _offsets[index]; r < _offsets[index + 1]; r++) {
+        unsigned int prim = _refs[r];
+        unsigned int &slot = mailbox[prim & (GRID_MAILBOX - 1)];
+        if (slot == prim) {
+          continue;  // Already tested in an earlier cell
+        }
+        slot = prim;
+        hit |= primTest(prim, tMax);
+      }
+
+      // A hit inside this cell cannot be beaten by a later one
+      int axis = tNext.x() < tNext.y() ? (tNext.x() < tNext.z() ? 0 : 2) : (tNext.y() < tNext.z() ? 1 : 2);
+      if (tMax <= tNext[axis] || tNext[axis] > tFar) {
+        break;
+      }
+      cell[axis] += step[axis];
+      if (cell[axis] < 0 || cell[axis] >= _res[axis]) {
+        break;
+      }
+      tNext[axis] += tDelta[axis];
+    }
+    return hit;
+  }
+};
+
+#endif //_GRID_H_
@@ -0,0 +1,18 @@
+#ifndef _HIT_H_
+#define _HIT_H_
+
+/**
+ * @brief Record of a ray hitting a triangle.
+ * Filled in by the intersection routines instead of storing the hit inside
+ * the geometry, so that any number of rays can be traced concurrently
+ * against the same model.
+ */
+struct Hit {
+  double t = 0;               ///< Ray parameter of the hit, in units of the ray direction
+  double u = 0;               ///< Barycentric weight of the triangle's second vertex
+  double v = 0;               ///< Barycentric weight of the triangle's third vertex
+  unsigned int triangle = 0;  ///< Index of the triangle in the mesh
+  unsigned int face = 0;      ///< Index of the face the triangle belongs to
+};
+
+#endif //_HIT_H_
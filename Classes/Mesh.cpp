@@ -0,0 +1,62 @@
+#include "Mesh.h"
+#include "Face.h"
+
+// Appends a vertex position
+unsigned int Mesh::addVertex(const Eigen::Vector3d &position) {
+  _positions.push_back(position);
+  return static_cast<unsigned int>(_positions.size() - 1);
+}
+
+// Appends a normal
+unsigned int Mesh::addNormal(const Eigen::Vector3d &normal) {
+  _normals.push_back(normal);
+  return static_cast<unsigned int>(_normals.size() - 1);
+}
+
+// Appends a face and its triangulation
+unsigned int Mesh::addFace(const std::vector<unsigned int> &vertices, const std::vector<unsigned int> &normals) {
+  unsigned int index = faceCount();
+  _faceVertices.insert(_faceVertices.end(), vertices.begin(), vertices.end());
+  _faceNormals.insert(_faceNormals.end(), normals.begin(), normals.end());
+  _faceOffsets.push_back(static_cast<unsigned int>(_faceVertices.size()));
+
+  // Each triangle takes the normals of the face vertices it is made of
+  Face face(*this, index);
+  for (unsigned int k = 0; k + 2 < face.size(); k++) {
+    triangle corners = face.cornersAt(k);
+    _triangles.push_back({vertices[corners[0]], vertices[corners[1]], vertices[corners[2]]});
+    _triangleFaces.push_back(index);
+    _triangleNormals.push_back({normals[corners[0]], normals[corners[1]], normals[corners[2]]});
+  }
+  return index;
+}
+
+// Moves every vertex by an offset
+void Mesh::translate(const Eigen::Vector3d &offset) {
+  for (Eigen::Vector3d &v : _positions) {
+    v += offset;
+  }
+}
+
+// Permutes the triangle buffers
+void Mesh::reorderTriangles(const std::vector<unsigned int> &order) {
+  std::vector<triangle> triangles(order.size());
+  std::vector<unsigned int> triangleFaces(order.size());
+  std::vector<triangle> triangleNormals(order.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    triangles[i] = _triangles[order[i]];
+    triangleFaces[i] = _triangleFaces[order[i]];
+    triangleNormals[i] = _triangleNormals[order[i]];
+  }
+  _triangles.swap(triangles);
+  _triangleFaces.swap(triangleFaces);
+  _triangleNormals.swap(triangleNormals);
+}
+
+// Computes the bounds of a triangle
+Eigen::AlignedBox3d Mesh::triangleBounds(unsigned int tri) const {
+  Eigen::AlignedBox3d box(_positions[_triangles[tri][0]]);
+  box.extend(_positions[_triangles[tri][1]]);
+  box.extend(_positions[_triangles[tri][2]]);
+  return box;
+}
@@ -0,0 +1,96 @@
+#ifndef _MESH_H_
+#define _MESH_H_
+
+#include <array>
+#include <vector>
+#include <Eigen/Dense>
+
+typedef std::array<unsigned int, 3> triangle;  // Vertex indices of a triangle
+
+/**
+ * @brief Flat, indexed storage for the geometry of a model.
+ * Positions and normals live in contiguous arrays and faces and triangles
+ * refer to them by index, so the intersection loop walks a few dense
+ * buffers instead of chasing pointers to scattered heap blocks. Every
+ * vertex of a face has a normal of its own, so a surface can be shaded
+ * smoothly across its triangles, or flat when they all share one.
+ */
+class Mesh {
+ private:
+  std::vector<Eigen::Vector3d> _positions;      ///< Vertex positions
+  std::vector<Eigen::Vector3d> _normals;        ///< Normals referenced by faces
+  std::vector<unsigned int> _faceVertices;      ///< Vertex indices of every face, back to back
+  std::vector<unsigned int> _faceNormals;       ///< Normal index at every vertex of every face, laid out as _faceVertices
+  std::vector<unsigned int> _faceOffsets = {0}; ///< Start of each face in _faceVertices, plus the end
+  std::vector<triangle> _triangles;             ///< Triangle index buffer
+  std::vector<unsigned int> _triangleFaces;     ///< Face index of each triangle
+  std::vector<triangle> _triangleNormals;       ///< Normal indices at the vertices of each triangle, in the same order
+
+ public:
+  /**
+   * @brief Appends a vertex position.
+   * @param position The position of the vertex.
+   * @return The index of the new vertex.
+   */
+  unsigned int addVertex(const Eigen::Vector3d &position);
+
+  /**
+   * @brief Appends a normal.
+   * @param normal The normal vector.
+   * @return The index of the new normal.
+   */
+  unsigned int addNormal(const Eigen::Vector3d &normal);
+
+  /**
+   * @brief Appends a face and its triangulation.
+   * @param vertices Indices of the face's vertices, in winding order.
+   * @param normals Index of the normal at each of those vertices.
+   * @return The index of the new face.
+   */
+  unsigned int addFace(const std::vector<unsigned int> &vertices, const std::vector<unsigned int> &normals);
+
+  /**
+   * @brief Moves every vertex by an offset.
+   * @param offset The offset to add to each position.
+   */
+  void translate(const Eigen::Vector3d &offset);
+
+  /**
+   * @brief Moves one vertex, keeping the faces that use it.
+   * @param i The index of the vertex.
+   * @param position Its new position.
+   */
+  void setPosition(unsigned int i, const Eigen::Vector3d &position) { _positions[i] = position; }
+
+  /**
+   * @brief Permutes the triangle buffers.
+   * @param order For every new position, the old index of the triangle stored there.
+   */
+  void reorderTriangles(const std::vector<unsigned int> &order);
+
+  /**
+   * @brief Computes the bounds of a triangle.
+   * @param tri The index of the triangle.
+   * @return The axis-aligned bounds of its three vertices.
+   */
+  Eigen::AlignedBox3d triangleBounds(unsigned int tri) const;
+
+  unsigned int vertexCount() const { return static_cast<unsigned int>(_positions.size()); }
+  unsigned int normalCount() const { return static_cast<unsigned int>(_normals.size()); }
+  unsigned int faceCount() const { return static_cast<unsigned int>(_faceOffsets.size() - 1); }
+  unsigned int triangleCount() const { return static_cast<unsigned int>(_triangles.size()); }
+
+  const Eigen::Vector3d &position(unsigned int i) const { return _positions[i]; }
+  const Eigen::Vector3d &normal(unsigned int i) const { return _normals[i]; }
+
+  const unsigned int *faceVertices(unsigned int face) const { return &_faceVertices[_faceOffsets[face]]; }
+  unsigned int faceSize(unsigned int face) const { return _faceOffsets[face + 1] - _faceOffsets[face]; }
+  const unsigned int *faceNormals(unsigned int face) const { return &_faceNormals[_faceOffsets[face]]; }
+  unsigned int faceNormal(unsigned int face) const { return _faceNormals[_faceOffsets[face]]; }
+
+  const triangle &getTriangle(unsigned int tri) const { return _triangles[tri]; }
+  unsigned int triangleFace(unsigned int tri) const { return _triangleFaces[tri]; }
+  const triangle &triangleNormals(unsigned int tri) const { return _triangleNormals[tri]; }
+};
+
+#endif //_MESH_H_
@@ -1,26 +1,101 @@
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include "Model.h"
 
 // Constructor that reads the object file and optionally centers the model
-Model::Model(std::ifstream &objectFile, bool center) {
+Model::Model(std::istream &objectFile, bool center) {
   readFile(objectFile);
   if (center) {
     centering();
   }
+  buildAccelerator();
 }
 
 // Center the model around the origin
 void Model::centering() {
-  Eigen::Vector3d antiVect = -_centerVector / static_cast<float>(_vertices.size());
-  for (v3DPtr &v : _vertices) {
-    *v += antiVect;
+  Eigen::Vector3d antiVect = -_centerVector / static_cast<float>(_mesh.vertexCount());
+  _mesh.translate(antiVect);
+}
+
+// Build the BVH over the triangles of every face, and the grid if it is in use
+void Model::buildAccelerator() {
+  _bvh.build(triangleBounds());
+  _mesh.reorderTriangles(_bvh.order());  // Every leaf becomes a contiguous range
+  _blocks = packTriangles(_mesh);
+  _bvhStale = false;
+  if (_accelerator == Accelerator::Grid) {
+    buildGrid();
+  }
+}
+
+// Rebuild the grid from the current vertex positions, in parallel
+void Model::buildGrid() {
+  _grid.build(triangleBounds(), ThreadPool::shared());
+}
+
+// Select the structure used to intersect rays, building the grid on first use
+void Model::setAccelerator(Accelerator accelerator) {
+  if (accelerator == Accelerator::Grid && _accelerator != Accelerator::Grid) {
+    buildGrid();
+  }
+  _accelerator = accelerator;
+  if (accelerator != Accelerator::Grid && _bvhStale) {
+    buildAccelerator();  // The vertices moved while the grid was in use
+  }
+}
+
+// Move every vertex, keeping the faces, and bring the accelerator in use up to date
+bool Model::setVertexPositions(const std::vector<Eigen::Vector3d> &positions) {
+  if (positions.size() != _mesh.vertexCount()) {
+    std::cerr << "Expected " << _mesh.vertexCount() << " vertex positions, got " << positions.size() << std::endl;
+    return false;
   }
+  for (unsigned int i = 0; i < _mesh.vertexCount(); i++) {
+    _mesh.setPosition(i, positions[i]);
+  }
+  switch (_accelerator) {
+    case Accelerator::Grid:
+      buildGrid();
+      _bvhStale = true;  // Rebuilding it every frame would defeat the grid
+      break;
+    case Accelerator::None:
+      _blocks = packTriangles(_mesh);  // The blocks hold copies of the vertices
+      _bvhStale = true;
+      break;
+    case Accelerator::BVH:
+    default:
+      buildAccelerator();  // The old bounds no longer hold
+      break;
+  }
+  return true;
+}
+
+// Bounds of every triangle, in mesh order
+std::vector<Eigen::AlignedBox3d> Model::triangleBounds() const {
+  std::vector<Eigen::AlignedBox3d> bounds(_mesh.triangleCount());
+  unsigned int chunks = (_mesh.triangleCount() + GRID_CHUNK - 1) / GRID_CHUNK;
+  ThreadPool::shared().parallelFor(chunks, [&](unsigned int c, unsigned int) {
+    for (unsigned int i = c * GRID_CHUNK; i < std::min(_mesh.triangleCount(), (c + 1) * GRID_CHUNK); i++) {
+      bounds[i] = _mesh.triangleBounds(i);
+    }
+  });
+  return bounds;
+}
+
+// Read-only access to the geometry
+const Mesh &Model::mesh() const {
+  return _mesh;
+}
+
+// View of one face of the model
+Face Model::face(unsigned int index) const {
+  return Face(_mesh, index);
 }
 
 // Read the object file
-void Model::readFile(std::ifstream &objectFile) {
+void Model::readFile(std::istream &objectFile) {
   std::string line;
   while (std::getline(objectFile, line)) {
     std::istringstream command(line);
@@ -42,18 +117,15 @@ std::string Model::factory(const std::string &command, std::istringstream &strea
   if (command == "v") {
     float x, y, z;
     stream >> x >> y >> z;
-    auto v = std::make_shared<Eigen::Vector3d>(x, y, z);
-    _centerVector += *v;
-    _vertices.push_back(v);
-    _vertexIndexMap[v] = _vertices.size();
+    Eigen::Vector3d v(x, y, z);
+    _centerVector += v;
+    _mesh.addVertex(v);
     return "Eigen::Vector3d";
   }
   if (command == "vn") {
     float x, y, z;
     stream >> x >> y >> z;
-    auto v = std::make_shared<Eigen::Vector3d>(x, y, z);
-    _vertexNormals.push_back(v);
-    _normalIndexMap[v] = _vertexNormals.size();
+    _mesh.addNormal(Eigen::Vector3d(x, y, z));
     return "VertexNormals";
   }
   if (command == "f") {
@@ -73,12 +145,12 @@ std::string Model::factory(const std::string &command, std::istringstream &strea
       vertNorm.emplace_back(std::stoi(temp));
     }
 
-    Face f(_vertexNormals[vertNorm[0] - 1]); // Assuming at least one normal
-    for (int index : vert) {
-      f.push_back(_vertices[index - 1]); // Adjust for 0-based indexing
+    std::vector<unsigned int> indices, normals;
+    for (size_t i = 0; i < vert.size(); i++) {
+      indices.push_back(vert[i] - 1); // Adjust for 0-based indexing
+      normals.push_back(vertNorm[i] - 1);
     }
-    f.triangulate();
-    _faces.push_back(f);
+    _mesh.addFace(indices, normals); // Assuming every vertex has a normal
     return "Faces";
   }
   return "Ignored";
@@ -95,16 +167,20 @@ std::string Model::toOBJ(const std::string &filePath) {
   std::ostringstream fileStream;
 
   fileStream << "o " << _name << "\n";
-  for (const auto &vertex : _vertices) {
-    fileStream << "v " << *vertex << "\n";
+  Eigen::Affine3d toWorld = objectToWorld();
+  Eigen::Matrix3d normalMatrix = normalToWorld();
+  for (unsigned int i = 0; i < _mesh.vertexCount(); i++) {
+    fileStream << "v " << toWorld * _mesh.position(i) << "\n";
   }
-  for (const auto &normal : _vertexNormals) {
-    fileStream << "vn " << *normal << "\n";
+  for (unsigned int i = 0; i < _mesh.normalCount(); i++) {
+    fileStream << "vn " << normalMatrix * _mesh.normal(i) << "\n";
   }
-  for (Face face : _faces) {
+  for (unsigned int i = 0; i < _mesh.faceCount(); i++) {
+    Face f = face(i);
     fileStream << "f ";
-    for (const auto &v : face.getVerts()) {
-      fileStream << std::to_string(_vertexIndexMap[v]) << "//" << std::to_string(_normalIndexMap[face.getNorm()]) << " ";
+    const unsigned int *normals = _mesh.faceNormals(i);
+    for (unsigned int v : f.getVerts()) {
+      fileStream << std::to_string(v + 1) << "//" << std::to_string(*normals++ + 1) << " ";
     }
     fileStream << "\n";
   }
@@ -122,33 +198,321 @@ std::string Model::toOBJ(const std::string &filePath) {
   return fileStream.str();
 }
 
-// Ray intersection check with the model
-bool Model::intersect(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir, Eigen::Vector3d &normal, Eigen::Vector3d &P) const {
-  double minDist = INFINITY;
-  bool flag = false;
+// Closest hit of a world-space ray before tMax
+bool Model::intersect(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir, Hit &hit, double tMax) const {
+  Eigen::Affine3d toObject = worldToObject();
+  return intersectObject(toObject * orig, toObject.linear() * dir, hit, tMax);
+}
 
-  for (Face face : _faces) {
-    if (face.intersectMT(orig, dir) && (face.getIntersect() - orig).norm() < minDist) {
-      P = face.getIntersect();
-      minDist = (P - orig).norm();
+// Closest hit of an object-space ray before tMax
+bool Model::intersectObject(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir, Hit &hit, double tMax) const {
+  switch (_accelerator) {
+    case Accelerator::None:
+      return intersectAll(orig, dir, hit, tMax);
+    case Accelerator::Grid:
+      return intersectGrid(orig, dir, hit, tMax);
+    case Accelerator::BVH:
+    default:
+      return intersectSubtree(orig, dir, hit, tMax, 0);
+  }
+}
+
+// Closest hit of an object-space ray, walking the grid
+bool Model::intersectGrid(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir, Hit &hit, double tMax) const {
+  bool found = false;
+  bool flag = _grid.intersect(orig, dir, tMax, [&](unsigned int tri, double &tLimit) {
+    const triangle &verts = _mesh.getTriangle(tri);
+    double t, u, v;
+    if (!Face::rayTriangleMT(orig, dir, _mesh.position(verts[0]), _mesh.position(verts[1]),
+                             _mesh.position(verts[2]), t, u, v) ||
+        !(t > EPSILON && t <= tLimit)) {
+      return false;
+    }
+    // Cells list their triangles in no set order, so of equally close hits the lowest triangle wins
+    if (t == tLimit && (!found || tri > hit.triangle)) {
+      return false;
+    }
+    found = true;
+    tLimit = t;
+    hit.u = u;
+    hit.v = v;
+    hit.triangle = tri;
+    return true;
+  });
+
+  if (flag) {
+    hit.t = tMax;
+    hit.face = _mesh.triangleFace(hit.triangle);
+  }
+  return flag;
+}
+
+// Closest hit of an object-space ray, testing every triangle
+bool Model::intersectAll(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir, Hit &hit, double tMax) const {
+  const BlockRay ray(orig, dir);
+  float tBlock = static_cast<float>(tMax);
+  bool flag = false;
+  for (unsigned int b = 0; b < _blocks.size(); b++) {
+    unsigned int lane;
+    float u, v;
+    if (intersectBlock(ray, _blocks[b], tBlock, lane, u, v)) {
+      hit.triangle = b * TRI_LANES + lane;
+      hit.u = u;
+      hit.v = v;
       flag = true;
-      normal = *face.getNorm();
     }
   }
+
+  if (flag) {
+    hit.t = tBlock;
+    hit.face = _mesh.triangleFace(hit.triangle);
+  }
+  return flag;
+}
+
+// Closest hit of an object-space ray inside one subtree of the BVH
+bool Model::intersectSubtree(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir, Hit &hit, double tMax,
+                             unsigned int node) const {
+  const BlockRay ray(orig, dir);
+
+  bool flag = _bvh.intersect(orig, dir, tMax, [&](unsigned int first, unsigned int count, double &tLimit) {
+    // Blocks straddling the leaf boundary also test a few neighbouring triangles, which is harmless
+    float tBlock = static_cast<float>(tLimit);
+    bool found = false;
+    for (unsigned int b = first / TRI_LANES; b <= (first + count - 1) / TRI_LANES; b++) {
+      unsigned int lane;
+      float u, v;
+      if (intersectBlock(ray, _blocks[b], tBlock, lane, u, v)) {
+        hit.triangle = b * TRI_LANES + lane;
+        hit.u = u;
+        hit.v = v;
+        found = true;
+      }
+    }
+    if (found) {
+      tLimit = tBlock;
+    }
+    return found;
+  }, node);
+
+  if (flag) {
+    hit.t = tMax;
+    hit.face = _mesh.triangleFace(hit.triangle);
+  }
   return flag; // Return whether an intersection occurred
 }
 
-// Rotate the model around the Z-axis
-void Model::rotate(double theta) {
-  Eigen::Matrix3d rot;
-  rot << cos(theta), -sin(theta), 0,
-      sin(theta), cos(theta),  0,
-      0,          0,           1;
+// Closest hits of an object-space ray packet
+uint64_t Model::intersectPacket(RayPacket &packet, Hit *hits) const {
+  if (_accelerator != Accelerator::BVH) {
+    // Only the BVH traces packets; the other structures take the rays one by one
+    for (uint64_t rays = packet.active; rays != 0; rays &= rays - 1) {
+      int r = __builtin_ctzll(rays);
+      Eigen::Vector3d dir(packet.dir[0][r], packet.dir[1][r], packet.dir[2][r]);
+      if (intersectObject(packet.origin, dir, hits[r], packet.t[r])) {
+        packet.hits |= uint64_t(1) << r;
+      }
+    }
+    return packet.hits;
+  }
+
+  packet.prepare();
+  floatv o[3];
+  for (int a = 0; a < 3; a++) {
+    o[a] = broadcast(static_cast<float>(packet.origin[a]));
+  }
+
+  auto leafTest = [&](unsigned int first, unsigned int count, uint64_t mask) {
+    for (unsigned int tri = first; tri < first + count; tri++) {
+      const TriangleBlock &block = _blocks[tri / TRI_LANES];
+      for (int g = 0; g < PACKET_LANES; g += SIMD_WIDTH) {
+        if ((mask >> g & ((uint64_t(1) << SIMD_WIDTH) - 1)) == 0) {
+          continue;  // No ray of this group is inside the leaf
+        }
+        floatv d[3] = {load(packet.dir[0] + g), load(packet.dir[1] + g), load(packet.dir[2] + g)};
+        floatv t = load(packet.t + g), u = load(packet.u + g), v = load(packet.v + g);
+        int hit = bits(intersectTriangle(o, d, block, tri % TRI_LANES, t, u, v));
+        if (hit == 0) {
+          continue;
+        }
+        store(packet.t + g, t);
+        store(packet.u + g, u);
+        store(packet.v + g, v);
+        packet.hits |= static_cast<uint64_t>(hit) << g;
+        for (; hit != 0; hit &= hit - 1) {
+          packet.triangle[g + __builtin_ctz(hit)] = tri;
+        }
+      }
+    }
+  };
+
+  auto rayTest = [&](unsigned int r, unsigned int node) {
+    Eigen::Vector3d dir(packet.dir[0][r], packet.dir[1][r], packet.dir[2][r]);
+    double tMax = packet.t[r];
+    Hit hit;
+    if (intersectSubtree(packet.origin, dir, hit, tMax, node)) {
+      packet.t[r] = static_cast<float>(hit.t);
+      packet.u[r] = static_cast<float>(hit.u);
+      packet.v[r] = static_cast<float>(hit.v);
+      packet.triangle[r] = hit.triangle;
+      packet.hits |= uint64_t(1) << r;
+    }
+  };
+
+  _bvh.intersect(packet, leafTest, rayTest);
+
+  for (uint64_t rays = packet.hits; rays != 0; rays &= rays - 1) {
+    int r = __builtin_ctzll(rays);
+    hits[r].t = packet.t[r];
+    hits[r].u = packet.u[r];
+    hits[r].v = packet.v[r];
+    hits[r].triangle = packet.triangle[r];
+    hits[r].face = _mesh.triangleFace(packet.triangle[r]);
+  }
+  return packet.hits;
+}
 
-  for (v3DPtr &v : _vertices) {
-    *v = rot * (*v);
+// Whether an object-space ray hits anything before tMax
+bool Model::occludedObject(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir, double tMax) const {
+  switch (_accelerator) {
+    case Accelerator::None: {
+      const BlockRay ray(orig, dir);
+      for (const TriangleBlock &block : _blocks) {
+        float tBlock = static_cast<float>(tMax), u, v;
+        unsigned int lane;
+        if (intersectBlock(ray, block, tBlock, lane, u, v)) {
+          return true;
+        }
+      }
+      return false;
+    }
+    case Accelerator::Grid:
+      return _grid.intersect(orig, dir, tMax, [&](unsigned int tri, double &tLimit) {
+        const triangle &verts = _mesh.getTriangle(tri);
+        double t, u, v;
+        if (tLimit <= 0 ||
+            !Face::rayTriangleMT(orig, dir, _mesh.position(verts[0]), _mesh.position(verts[1]),
+                                 _mesh.position(verts[2]), t, u, v) ||
+            !(t > EPSILON && t < tLimit)) {
+          return false;
+        }
+        tLimit = 0;  // Ends the walk after this cell
+        return true;
+      });
+    case Accelerator::BVH:
+    default:
+      return occludedSubtree(orig, dir, tMax, 0);
   }
-  for (v3DPtr &n : _vertexNormals) {
-    *n = rot * (*n);
+}
+
+// Whether an object-space ray hits anything before tMax inside one subtree of the BVH
+bool Model::occludedSubtree(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir, double tMax,
+                            unsigned int node) const {
+  const BlockRay ray(orig, dir);
+  return _bvh.occluded(orig, dir, tMax, [&](unsigned int first, unsigned int count) {
+    for (unsigned int b = first / TRI_LANES; b <= (first + count - 1) / TRI_LANES; b++) {
+      float tBlock = static_cast<float>(tMax), u, v;
+      unsigned int lane;
+      if (intersectBlock(ray, _blocks[b], tBlock, lane, u, v)) {
+        return true;
+      }
+    }
+    return false;
+  }, node);
+}
+
+// Rays of an object-space packet hitting anything before their t
+uint64_t Model::occludedPacket(RayPacket &packet) const {
+  if (_accelerator != Accelerator::BVH) {
+    for (uint64_t rays = packet.active; rays != 0; rays &= rays - 1) {
+      int r = __builtin_ctzll(rays);
+      Eigen::Vector3d dir(packet.dir[0][r], packet.dir[1][r], packet.dir[2][r]);
+      if (occludedObject(packet.origin, dir, packet.t[r])) {
+        packet.hits |= uint64_t(1) << r;
+      }
+    }
+    return packet.hits;
+  }
+
+  packet.prepare();
+  floatv o[3];
+  for (int a = 0; a < 3; a++) {
+    o[a] = broadcast(static_cast<float>(packet.origin[a]));
   }
+
+  // A ray that found an occluder gets an empty interval, so the next slab test drops it from the packet
+  auto retire = [&](uint64_t rays) {
+    packet.hits |= rays;
+    for (; rays != 0; rays &= rays - 1) {
+      packet.t[__builtin_ctzll(rays)] = -INFINITY;
+    }
+  };
+
+  auto leafTest = [&](unsigned int first, unsigned int count, uint64_t mask) {
+    for (unsigned int tri = first; tri < first + count && mask != 0; tri++) {
+      const TriangleBlock &block = _blocks[tri / TRI_LANES];
+      for (int g = 0; g < PACKET_LANES; g += SIMD_WIDTH) {
+        if ((mask >> g & ((uint64_t(1) << SIMD_WIDTH) - 1)) == 0) {
+          continue;  // No ray of this group is still looking inside the leaf
+        }
+        floatv d[3] = {load(packet.dir[0] + g), load(packet.dir[1] + g), load(packet.dir[2] + g)};
+        floatv t = load(packet.t + g), u = broadcast(0.0f), v = u;
+        uint64_t hit = static_cast<uint64_t>(bits(intersectTriangle(o, d, block, tri % TRI_LANES, t, u, v))) << g;
+        retire(hit & mask);
+        mask &= ~hit;
+      }
+    }
+  };
+
+  auto rayTest = [&](unsigned int r, unsigned int node) {
+    Eigen::Vector3d dir(packet.dir[0][r], packet.dir[1][r], packet.dir[2][r]);
+    if (occludedSubtree(packet.origin, dir, packet.t[r], node)) {
+      retire(uint64_t(1) << r);
+    }
+  };
+
+  _bvh.intersect(packet, leafTest, rayTest);
+  return packet.hits;
+}
+
+// Object-space normal at a hit, blended from the normals at the triangle's vertices
+Eigen::Vector3d Model::hitNormal(const Hit &hit) const {
+  const triangle &normals = _mesh.triangleNormals(hit.triangle);
+  if (normals[0] == normals[1] && normals[1] == normals[2]) {
+    return _mesh.normal(normals[0]);  // Flat shaded
+  }
+  return ((1 - hit.u - hit.v) * _mesh.normal(normals[0]) + hit.u * _mesh.normal(normals[1]) +
+          hit.v * _mesh.normal(normals[2])).normalized();
+}
+
+// Transform taking object-space points to world space
+Eigen::Affine3d Model::objectToWorld() const {
+  return Eigen::Translation3d(_translation) * _rotation * Eigen::Scaling(_scale);
+}
+
+// Transform taking world-space points to object space
+Eigen::Affine3d Model::worldToObject() const {
+  return Eigen::Scaling(1 / _scale) * _rotation.conjugate() * Eigen::Translation3d(-_translation);
+}
+
+// Matrix taking object-space normals to world space; uniform scale leaves them parallel
+Eigen::Matrix3d Model::normalToWorld() const {
+  return _rotation.toRotationMatrix();
+}
+
+// Rotate the model around the world Z-axis
+void Model::rotate(double theta) {
+  Eigen::Quaterniond rot(Eigen::AngleAxisd(theta, Eigen::Vector3d::UnitZ()));
+  _rotation = (rot * _rotation).normalized();  // Renormalize so drift cannot build up
+  _translation = rot * _translation;
+}
+
+// Move the model by an offset in world space
+void Model::translate(const Eigen::Vector3d &offset) {
+  _translation += offset;
+}
+
+// Scale the model uniformly about its origin
+void Model::scale(double factor) {
+  _scale *= factor;
 }
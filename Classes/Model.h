@@ -1,28 +1,55 @@
 #ifndef _MODEL_H_
 #define _MODEL_H_
 
+#include <istream>
 #include <string>
 #include <vector>
-#include <unordered_map>
-#include <memory>      // Include for std::shared_ptr
 #include "Face.h"
+#include "Mesh.h"
+#include "BVH.h"
+#include "Grid.h"
+#include "TriangleBlock.h"
 
-// Define a shared pointer type for Eigen::Vector3d
-typedef std::shared_ptr<Eigen::Vector3d> v3DPtr;
+// Structure used to find the triangles a ray may hit
+enum class Accelerator {
+  None,  // Every triangle is tested, for reference
+  BVH,   // Bounding volume hierarchy, fastest for static meshes
+  Grid   // Uniform grid, cheapest to rebuild for deforming meshes
+};
 
 class Model {
  private:
   std::string _name;                          // Name of the model
-  std::vector<v3DPtr> _vertices;              // Vertices of the model
-  std::vector<v3DPtr> _vertexNormals;         // Normals for each vertex
-  std::vector<Face> _faces;                    // Faces of the model
-  std::unordered_map<v3DPtr, unsigned long> _vertexIndexMap; // Mapping from vertex pointers to their indices
-  std::unordered_map<v3DPtr, unsigned long> _normalIndexMap; // Mapping from normal pointers to their indices
+  Mesh _mesh;                                 // Geometry of the model, triangles in BVH order
   Eigen::Vector3d _centerVector = Eigen::Vector3d(0, 0, 0); // Center of the model
+  BVH _bvh;                                   // Acceleration structure over the mesh triangles
+  std::vector<TriangleBlock> _blocks;         // Mesh triangles packed for the SIMD kernel, in BVH order
+  Grid _grid;                                 // Uniform grid over the mesh triangles
+  Accelerator _accelerator = Accelerator::BVH; // Structure used by intersectObject()
+  bool _bvhStale = false;                     // Whether the vertices moved since the BVH and blocks were built
+  Eigen::Quaterniond _rotation = Eigen::Quaterniond::Identity(); // Model-to-world rotation
+  Eigen::Vector3d _translation = Eigen::Vector3d(0, 0, 0);      // Model-to-world translation
+  double _scale = 1;                                             // Model-to-world uniform scale
+
+  // Closest hit of an object-space ray inside one subtree of the BVH
+  bool intersectSubtree(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir, Hit &hit, double tMax,
+                        unsigned int node) const;
+
+  // Whether an object-space ray hits anything before tMax inside one subtree of the BVH
+  bool occludedSubtree(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir, double tMax, unsigned int node) const;
+
+  // Closest hit of an object-space ray, walking the grid
+  bool intersectGrid(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir, Hit &hit, double tMax) const;
+
+  // Closest hit of an object-space ray, testing every triangle
+  bool intersectAll(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir, Hit &hit, double tMax) const;
+
+  // Bounds of every triangle, in mesh order
+  std::vector<Eigen::AlignedBox3d> triangleBounds() const;
 
  public:
   // Constructor to initialize the model from an object file, optionally centering it
-  explicit Model(std::ifstream &objectFile, bool center = true);
+  explicit Model(std::istream &objectFile, bool center = true);
 
   // Factory method to parse commands from the object file
   std::string factory(const std::string &command, std::istringstream &stream);
@@ -31,16 +58,75 @@ class Model {
   std::string toOBJ(const std::string &filePath = "");
 
   // Read the object file
-  void readFile(std::ifstream &objectFile);
+  void readFile(std::istream &objectFile);
 
   // Center the model around the origin
   void centering();
 
-  // Check for ray intersection with the model
-  bool intersect(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir, Eigen::Vector3d &normal, Eigen::Vector3d &P) const;
+  // Build the BVH over the triangles of every face, and the grid if it is in use
+  void buildAccelerator();
+
+  // Rebuild the grid from the current vertex positions, in parallel
+  void buildGrid();
+
+  // Select the structure used to intersect rays, building the grid on first use
+  // and rebuilding the BVH if the vertices moved while it was not in use
+  void setAccelerator(Accelerator accelerator);
+
+  // Move every vertex, keeping the faces, and bring the accelerator in use up to
+  // date: the grid is rebuilt, which is what it is for, and the BVH is rebuilt
+  // from scratch. Structures not in use are rebuilt once selected. Vertex normals
+  // are left as they are. Returns false if the count differs from the mesh's
+  bool setVertexPositions(const std::vector<Eigen::Vector3d> &positions);
+
+  // Read-only access to the geometry
+  const Mesh &mesh() const;
+
+  // View of one face of the model
+  Face face(unsigned int index) const;
 
-  // Rotate the model around the Z-axis
+  // Closest hit of a world-space ray before tMax. Safe to call concurrently;
+  // t is in units of dir, so the hit point is orig + hit.t * dir
+  bool intersect(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir, Hit &hit, double tMax = INFINITY) const;
+
+  // Closest hit of an object-space ray before tMax. t is the same as in world
+  // space when dir was mapped by worldToObject()
+  bool intersectObject(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir, Hit &hit, double tMax = INFINITY) const;
+
+  // Closest hits of an object-space ray packet. Fills hits[r] for every ray r
+  // set in the returned mask
+  uint64_t intersectPacket(RayPacket &packet, Hit *hits) const;
+
+  // Whether an object-space ray hits anything before tMax. Stops at the first
+  // triangle found instead of looking for the closest one
+  bool occludedObject(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir, double tMax) const;
+
+  // Rays of an object-space packet hitting anything before their t, each one
+  // dropping out of the traversal at the first triangle found. Leaves the
+  // packet's t and barycentrics undefined
+  uint64_t occludedPacket(RayPacket &packet) const;
+
+  // Object-space normal at a hit, interpolated from the triangle's vertex
+  // normals with the hit's barycentrics
+  Eigen::Vector3d hitNormal(const Hit &hit) const;
+
+  // Transform taking object-space points to world space
+  Eigen::Affine3d objectToWorld() const;
+
+  // Transform taking world-space points to object space
+  Eigen::Affine3d worldToObject() const;
+
+  // Matrix taking object-space normals to world space
+  Eigen::Matrix3d normalToWorld() const;
+
+  // Rotate the model around the world Z-axis
   void rotate(double theta);
+
+  // Move the model by an offset in world space
+  void translate(const Eigen::Vector3d &offset);
+
+  // Scale the model uniformly about its origin
+  void scale(double factor);
 };
 
 #endif //_MODEL_H_
@@ -0,0 +1,197 @@
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include "Player.h"
+
+// Maps a recording into memory
+Player::Player(const std::string &path) {
+  _fd = open(path.c_str(), O_RDONLY);
+  struct stat info;
+  if (_fd == -1 || fstat(_fd, &info) == -1) {
+    std::cerr << "Unable to open recording " << path << std::endl;
+    return;
+  }
+  _size = static_cast<size_t>(info.st_size);
+  RecordHeader header;
+  if (_size < sizeof(header)) {
+    std::cerr << "Not a recording: " << path << std::endl;
+    return;
+  }
+  void *data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+  if (data == MAP_FAILED) {
+    std::cerr << "Unable to map recording " << path << std::endl;
+    return;
+  }
+  _data = static_cast<const char *>(data);
+  madvise(data, _size, MADV_SEQUENTIAL);  // Playback reads front to back
+
+  std::memcpy(&header, _data, sizeof(header));
+  if (std::memcmp(header.magic, RECORD_MAGIC, sizeof(header.magic)) != 0) {
+    std::cerr << "Not a recording: " << path << std::endl;
+    munmap(data, _size);
+    _data = nullptr;
+    return;
+  }
+  if (header.indexOffset != 0 && header.indexOffset <= _size &&
+      header.frames <= (_size - header.indexOffset) / sizeof(RecordIndex)) {
+    _index = _data + header.indexOffset;
+    _frames = header.frames;
+  } else {
+    scan();  // Recording stopped before the index was written
+  }
+}
+
+// Unmaps the recording
+Player::~Player() {
+  if (_data) {
+    munmap(const_cast<char *>(_data), _size);
+  }
+  if (_fd != -1) {
+    close(_fd);
+  }
+}
+
+// Checks whether the recording could be opened
+bool Player::isOpen() const {
+  return _data != nullptr;
+}
+
+// Returns the number of frames in the recording
+size_t Player::frameCount() const {
+  return _frames;
+}
+
+// Reads one entry of the frame index
+RecordIndex Player::entry(size_t frame) const {
+  RecordIndex entry;
+  std::memcpy(&entry, _index + frame * sizeof(RecordIndex), sizeof(entry));
+  return entry;
+}
+
+// Reads the header of a frame, checking that the frame fits in the file
+bool Player::frameAt(uint64_t offset, RecordFrame &frame) const {
+  if (offset > _size || _size - offset < sizeof(frame)) {
+    return false;
+  }
+  std::memcpy(&frame, _data + offset, sizeof(frame));
+  return frame.size <= _size - offset - sizeof(frame);
+}
+
+// Rebuilds the index of a recording that was never finished
+void Player::scan() {
+  uint64_t offset = sizeof(RecordHeader);
+  RecordFrame frame;
+  while (frameAt(offset, frame)) {
+    _scanned.push_back({offset, frame.micros});
+    offset += sizeof(frame) + frame.size;
+  }
+  _index = reinterpret_cast<const char *>(_scanned.data());
+  _frames = _scanned.size();
+}
+
+// Unpacks one frame over the frame before it
+bool Player::apply(size_t index) {
+  RecordFrame frame;
+  if (!frameAt(entry(index).offset, frame) || frame.colorMode > static_cast<int>(ColorMode::TrueColor) ||
+      (frame.cellBytes != 1 && frame.cellBytes != CELL_UTF8)) {
+    return false;
+  }
+  const int rows = frame.rows, cols = frame.cols;
+  if (rows != static_cast<int>(_canvas.rows()) || cols != static_cast<int>(_canvas.cols()) ||
+      frame.cellBytes != _canvas.cellBytes() || static_cast<ColorMode>(frame.colorMode) != _canvas.colorMode()) {
+    if (!frame.keyframe) {
+      return false;  // A delta only applies to a frame of its own layout
+    }
+    _canvas.reshape(rows, cols, frame.cellBytes, static_cast<ColorMode>(frame.colorMode));
+  }
+
+  const char *in = _data + entry(index).offset + sizeof(frame);
+  const char *end = in + frame.size;
+  uint32_t *colors = _canvas.colors();
+  for (int k = 0; k < frame.changedRows; k++) {
+    uint16_t row;
+    if (end - in < static_cast<ptrdiff_t>(sizeof(row))) {
+      return false;
+    }
+    std::memcpy(&row, in, sizeof(row));
+    in += sizeof(row);
+    if (row >= rows) {
+      return false;
+    }
+    if (cols == 0) {
+      continue;  // Nothing to unpack, and no cell to point at
+    }
+    in = Recorder::unpackRuns(in, end, &_canvas[static_cast<size_t>(row) * cols], cols, frame.cellBytes);
+    if (in && colors) {
+      in = Recorder::unpackRuns(in, end, reinterpret_cast<char *>(colors + 2 * static_cast<size_t>(row) * cols), cols,
+                                2 * sizeof(uint32_t));
+    }
+    if (!in) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Unpacks a frame, replaying from the keyframe before it
+bool Player::seek(size_t frame) {
+  if (frame >= _frames) {
+    return false;
+  }
+  size_t keyframe = frame;
+  RecordFrame header;
+  while (keyframe > 0 && frameAt(entry(keyframe).offset, header) && !header.keyframe) {
+    keyframe--;
+  }
+  for (size_t f = keyframe; f <= frame; f++) {
+    if (!apply(f)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Finds the frame showing at a time
+size_t Player::frameAtTime(double seconds) const {
+  uint64_t micros = seconds > 0 ? static_cast<uint64_t>(seconds * 1e6) : 0;
+  size_t lo = 0, hi = _frames;
+  while (hi - lo > 1) {
+    size_t mid = (lo + hi) / 2;
+    if (entry(mid).micros <= micros) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+// Writes the frames from one on to a terminal at their recorded pace
+bool Player::play(int fd, size_t first) {
+  if (first >= _frames) {
+    return true;
+  }
+  auto start = std::chrono::steady_clock::now();
+  uint64_t firstMicros = entry(first).micros;
+  for (size_t f = first; f < _frames; f++) {
+    if (!(f == first ? seek(f) : apply(f))) {
+      std::cerr << "Corrupt recording at frame " << f << "." << std::endl;
+      return false;
+    }
+    std::this_thread::sleep_until(start + std::chrono::microseconds(entry(f).micros - firstMicros));
+
+    // The encoder keeps the canvas it is given, so it gets a copy and _canvas stays the reference for the next delta
+    _shown = _canvas;
+    _encoder.encode(_shown);
+    if (!_encoder.write(fd)) {
+      std::cerr << "Failed to write the frame." << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,107 @@
+#ifndef _PLAYER_H_
+#define _PLAYER_H_
+
+#include <string>
+#include <vector>
+#include "Canvas.h"
+#include "FrameEncoder.h"
+#include "Recorder.h"
+
+/**
+ * @brief Plays a recording back to a terminal without rendering anything.
+ * The file is mapped into memory rather than read, and each frame's rows
+ * are unpacked straight from the mapping into a canvas that the frame
+ * encoder then sends, at the times the frames were recorded. Seeking goes
+ * through the frame index to the keyframe before the target and replays
+ * from there.
+ */
+class Player {
+ private:
+  int _fd = -1;                       ///< The recording file
+  const char *_data = nullptr;        ///< The mapped file, nullptr if it could not be opened
+  size_t _size = 0;                   ///< Bytes of the mapped file
+  const char *_index = nullptr;       ///< The frame index, in the mapping or in _scanned
+  size_t _frames = 0;                 ///< Frames in the recording
+  std::vector<RecordIndex> _scanned;  ///< Index rebuilt from the frames of a recording cut short
+  Canvas _canvas{0, 0};               ///< The frame last unpacked
+  Canvas _shown{0, 0};                ///< Copy of _canvas handed to the encoder, which takes its buffers
+  FrameEncoder _encoder;              ///< Turns frames into terminal updates
+
+  /**
+   * @brief Reads one entry of the frame index.
+   * @param frame The frame.
+   * @return Its offset and time.
+   */
+  RecordIndex entry(size_t frame) const;
+
+  /**
+   * @brief Reads the header of a frame, checking that the frame fits in the file.
+   * @param offset Where the frame starts.
+   * @param frame Receives the header.
+   * @return True if the whole frame is in the file.
+   */
+  bool frameAt(uint64_t offset, RecordFrame &frame) const;
+
+  /**
+   * @brief Rebuilds the index of a recording that was never finished.
+   */
+  void scan();
+
+  /**
+   * @brief Unpacks one frame over the frame before it.
+   * @param index The frame.
+   * @return False if the frame is corrupt.
+   */
+  bool apply(size_t index);
+
+ public:
+  /**
+   * @brief Maps a recording into memory.
+   * @param path The path of the recording.
+   */
+  explicit Player(const std::string &path);
+
+  /**
+   * @brief Unmaps the recording.
+   */
+  ~Player();
+
+  Player(const Player &) = delete;
+  Player &operator=(const Player &) = delete;
+
+  /**
+   * @brief Checks whether the recording could be opened.
+   * @return True if it can be played.
+   */
+  bool isOpen() const;
+
+  /**
+   * @brief Returns the number of frames in the recording.
+   * @return The frame count.
+   */
+  size_t frameCount() const;
+
+  /**
+   * @brief Finds the frame showing at a time.
+   * @param seconds The time from the first frame.
+   * @return The last frame recorded at or before that time.
+   */
+  size_t frameAtTime(double seconds) const;
+
+  /**
+   * @brief Unpacks a frame, replaying from the keyframe before it.
+   * @param frame The frame.
+   * @return False if a frame on the way is corrupt.
+   */
+  bool seek(size_t frame);
+
+  /**
+   * @brief Writes the frames from one on to a terminal at their recorded pace.
+   * @param fd The file descriptor of the terminal.
+   * @param first The first frame to show.
+   * @return False if the recording is corrupt or the terminal could not be written.
+   */
+  bool play(int fd, size_t first = 0);
+};
+
+#endif //_PLAYER_H_
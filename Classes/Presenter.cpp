@@ -0,0 +1,101 @@
+#include <chrono>
+#include <iostream>
+#include "Presenter.h"
+
+// Starts the presenter thread
+Presenter::Presenter(int fd) : _fd(fd) {
+  std::cout.flush();  // Anything already printed goes first
+  _thread = std::thread(&Presenter::run, this);
+}
+
+// Presents the last pending frame and stops the presenter thread
+Presenter::~Presenter() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stop = true;
+  }
+  _wake.notify_one();
+  _thread.join();
+}
+
+// Hands a finished canvas over to the presenter without waiting for the terminal
+void Presenter::submit(Canvas &canvas) {
+  Canvas &back = _slots[_back];
+  if (!back.sameLayout(canvas)) {
+    back = canvas;  // A new size needs a buffer of its own
+  } else {
+    back.swap(canvas);
+  }
+
+  // Publish the back slot; whatever was pending becomes the next back slot
+  unsigned int previous = _pending.exchange(_back | PRESENT_FRESH, std::memory_order_acq_rel);
+  _back = previous & ~PRESENT_FRESH;
+  if (previous & PRESENT_FRESH) {
+    _dropped.fetch_add(1, std::memory_order_relaxed);  // The presenter never saw it
+  }
+
+  // The lock only orders the wake-up against the presenter going to sleep
+  { std::lock_guard<std::mutex> lock(_mutex); }
+  _wake.notify_one();
+}
+
+// Main loop of the presenter thread
+void Presenter::run() {
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _wake.wait(lock, [this] {
+        return _stop || (_pending.load(std::memory_order_acquire) & PRESENT_FRESH);
+      });
+      if (!(_pending.load(std::memory_order_acquire) & PRESENT_FRESH)) {
+        return;  // Stopping with nothing left to show
+      }
+    }
+
+    // Take the pending frame and give back the one on screen
+    _front = _pending.exchange(_front, std::memory_order_acq_rel) & ~PRESENT_FRESH;
+    if (_invalid.exchange(false, std::memory_order_relaxed)) {
+      _encoder.invalidate();
+    }
+    _encoder.encode(_slots[_front]);
+    auto start = std::chrono::steady_clock::now();
+    if (!_encoder.write(_fd) && !_failed.exchange(true, std::memory_order_relaxed)) {
+      std::cerr << "Failed to write the frame." << std::endl;  // Once, rather than for every frame after it
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    _bytes.fetch_add(_encoder.size(), std::memory_order_relaxed);
+    _writeNanos.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+                          std::memory_order_relaxed);
+    _presented.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+// Forgets what is on screen, so the next frame is redrawn in full
+void Presenter::invalidate() {
+  _invalid.store(true, std::memory_order_relaxed);
+}
+
+// Checks whether writing to the terminal ever failed
+bool Presenter::failed() const {
+  return _failed.load(std::memory_order_relaxed);
+}
+
+// Returns the number of frames written to the terminal so far
+unsigned long Presenter::presented() const {
+  return _presented.load(std::memory_order_relaxed);
+}
+
+// Returns the number of frames dropped because the terminal fell behind
+unsigned long Presenter::dropped() const {
+  return _dropped.load(std::memory_order_relaxed);
+}
+
+// Returns the number of bytes written to the terminal so far
+unsigned long long Presenter::bytesWritten() const {
+  return _bytes.load(std::memory_order_relaxed);
+}
+
+// Returns the time spent writing to the terminal so far
+double Presenter::writeSeconds() const {
+  return _writeNanos.load(std::memory_order_relaxed) * 1e-9;
+}
@@ -0,0 +1,109 @@
+#ifndef _PRESENTER_H_
+#define _PRESENTER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "Canvas.h"
+#include "FrameEncoder.h"
+
+#define PRESENT_SLOTS 3       // Canvases in flight: one drawn, one pending, one on screen
+#define PRESENT_FRESH 4u      // Set in the pending slot index while its frame is unpresented
+
+/**
+ * @brief Background thread that owns the terminal output.
+ * Rendered canvases are handed over through a lock-free single-producer,
+ * single-consumer triple buffer. The renderer swaps its finished canvas into
+ * the back slot and exchanges that slot with the pending one; the presenter
+ * exchanges the pending slot with the one it last showed. If the renderer
+ * submits again before the presenter took the pending frame, that older
+ * frame is dropped, so a slow terminal never stalls rendering.
+ */
+class Presenter {
+ private:
+  Canvas _slots[PRESENT_SLOTS] = {{0, 0}, {0, 0}, {0, 0}};  ///< Canvases cycling between the two threads
+  unsigned int _back = 0;                   ///< Slot the renderer fills next, renderer only
+  unsigned int _front = 1;                  ///< Slot last presented, presenter only
+  std::atomic<unsigned int> _pending{2};    ///< Slot waiting to be presented, with PRESENT_FRESH if it is new
+  FrameEncoder _encoder;                    ///< Turns frames into terminal updates, presenter only
+  int _fd;                                  ///< File descriptor of the terminal
+  std::atomic<unsigned long> _presented{0}; ///< Frames written to the terminal
+  std::atomic<unsigned long> _dropped{0};   ///< Frames replaced before they could be written
+  std::atomic<unsigned long long> _bytes{0};      ///< Bytes written to the terminal
+  std::atomic<unsigned long long> _writeNanos{0}; ///< Nanoseconds spent blocked in writes
+  std::atomic<bool> _invalid{false};        ///< Set when the screen must be redrawn in full
+  std::atomic<bool> _failed{false};         ///< Set once a write failed
+  std::atomic<bool> _stop{false};           ///< Set when the presenter shuts down
+  std::mutex _mutex;                        ///< Only used to sleep while nothing is pending
+  std::condition_variable _wake;            ///< Signals the presenter that a frame is pending
+  std::thread _thread;                      ///< The presenter thread
+
+  /**
+   * @brief Main loop of the presenter thread.
+   */
+  void run();
+
+ public:
+  /**
+   * @brief Starts the presenter thread.
+   * @param fd The file descriptor of the terminal.
+   */
+  explicit Presenter(int fd);
+
+  /**
+   * @brief Presents the last pending frame and stops the presenter thread.
+   */
+  ~Presenter();
+
+  Presenter(const Presenter &) = delete;
+  Presenter &operator=(const Presenter &) = delete;
+
+  /**
+   * @brief Hands a finished canvas over to the presenter without waiting for the terminal.
+   * The canvas is swapped with a free slot, so it comes back holding an old
+   * frame for the caller to draw over. Only the first frame of a new size is
+   * copied, leaving the canvas as it was.
+   * @param canvas The finished canvas.
+   */
+  void submit(Canvas &canvas);
+
+  /**
+   * @brief Forgets what is on screen, so the next frame is redrawn in full.
+   */
+  void invalidate();
+
+  /**
+   * @brief Checks whether writing to the terminal ever failed, as it does once a socket's peer is gone.
+   * @return True after the first failed write.
+   */
+  bool failed() const;
+
+  /**
+   * @brief Returns the number of frames written to the terminal so far.
+   * @return The presented frame count.
+   */
+  unsigned long presented() const;
+
+  /**
+   * @brief Returns the number of frames dropped because the terminal fell behind.
+   * @return The dropped frame count.
+   */
+  unsigned long dropped() const;
+
+  /**
+   * @brief Returns the number of bytes written to the terminal so far.
+   * @return The byte count.
+   */
+  unsigned long long bytesWritten() const;
+
+  /**
+   * @brief Returns the time spent writing to the terminal so far.
+   * Dividing the bytes written by it gives the throughput of the link to
+   * the terminal, as writes block once its buffers are full.
+   * @return The time in seconds.
+   */
+  double writeSeconds() const;
+};
+
+#endif //_PRESENTER_H_
@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <cmath>
+#include "QualityController.h"
+
+// Constructs a controller starting at full quality
+QualityController::QualityController(double fps, double byteRate, ColorMode maxColor)
+    : _frameTime(1 / fps), _byteRate(byteRate), _maxColor(maxColor), _color(maxColor), _interval(1 / fps) {}
+
+// Accounts for one rendered frame and, at the end of a window, adjusts the quality
+bool QualityController::update(double renderSeconds, const Presenter &presenter) {
+  _renderTime += renderSeconds;
+  if (++_frames < QUALITY_WINDOW) {
+    return false;
+  }
+
+  // Close the window
+  unsigned long presented = presenter.presented();
+  unsigned long long bytes = presenter.bytesWritten();
+  double writeTime = presenter.writeSeconds();
+  double frames = static_cast<double>(presented - _presented);
+  double sent = static_cast<double>(bytes - _bytes);
+  double writing = writeTime - _writeTime;
+  double render = _renderTime / _frames;
+  _presented = presented;
+  _bytes = bytes;
+  _writeTime = writeTime;
+  _frames = 0;
+  _renderTime = 0;
+  if (_settling) {
+    _settling = false;  // The first frame and every change redraw the whole screen, unlike the frames after them
+    return false;
+  }
+  _sinceRaise = std::min(_sinceRaise + 1, QUALITY_MAX_PATIENCE);
+
+  // Shares of the frame time spent rendering and sending a frame, and of the bytes a frame may take
+  double cpu = render / _frameTime;
+  double link = INFINITY;  // A window without a single frame presented means the terminal is stalled
+  _interval = QUALITY_MAX_INTERVAL;
+  if (frames > 0) {
+    double frameBytes = sent / frames;
+    double frameWrite = writing / frames;
+    link = frameWrite / _frameTime;
+    if (_byteRate > 0) {
+      link = std::max(link, frameBytes / (_byteRate * _frameTime));
+    }
+    // Render no faster than the terminal and the budget take the frames
+    double interval = std::max(_frameTime, frameWrite);
+    if (_byteRate > 0) {
+      interval = std::max(interval, frameBytes / _byteRate);
+    }
+    _interval = std::min(interval, QUALITY_MAX_INTERVAL);
+  }
+
+  bool lowered = false, raised = false;
+  if (link > QUALITY_HIGH) {
+    // Colour costs the most bytes for the least detail, so it goes first
+    if (_color != ColorMode::None) {
+      _color = static_cast<ColorMode>(static_cast<int>(_color) - 1);
+      lowered = true;
+    } else if (_scale < QUALITY_MAX_SCALE) {
+      _scale++;
+      lowered = true;
+    }
+    _headroom = 0;
+  } else if (cpu > QUALITY_HIGH) {
+    if (_scale < QUALITY_MAX_SCALE) {
+      _scale++;
+      lowered = true;
+    }
+    _headroom = 0;
+  } else if (++_headroom >= _patience) {
+    // Both the rays and the changed cells grow with the square of the resolution
+    double growth = _scale > 1 ? std::pow(_scale / (_scale - 1.0), 2) : INFINITY;
+    if (cpu * growth < QUALITY_LOW && link * growth < QUALITY_LOW) {
+      _scale--;
+      raised = true;
+    } else if (_color != _maxColor && link * QUALITY_COLOR_COST < QUALITY_LOW) {
+      _color = static_cast<ColorMode>(static_cast<int>(_color) + 1);
+      raised = true;
+    }
+  }
+
+  // An increase that did not last makes the next one wait longer; one that did resets the wait
+  if (lowered) {
+    if (_sinceRaise <= QUALITY_PATIENCE) {
+      _patience = std::min(_patience * 2, QUALITY_MAX_PATIENCE);
+    }
+    _sinceRaise = QUALITY_MAX_PATIENCE;
+  } else if (_sinceRaise == QUALITY_PATIENCE + 1) {
+    _patience = QUALITY_PATIENCE;
+  }
+  if (raised) {
+    _sinceRaise = 0;
+  }
+  if (lowered || raised) {
+    _headroom = 0;
+    _settling = true;
+  }
+  return lowered || raised;
+}
@@ -0,0 +1,86 @@
+#ifndef _QUALITY_CONTROLLER_H_
+#define _QUALITY_CONTROLLER_H_
+
+#include "Canvas.h"
+#include "Presenter.h"
+
+#define QUALITY_FPS 60            // Frame rate aimed for unless told otherwise
+#define QUALITY_WINDOW 16         // Frames measured before each decision
+#define QUALITY_MAX_SCALE 4       // Coarsest render scale, in samples along each axis per ray
+#define QUALITY_MAX_INTERVAL 0.25 // Longest time between frames, in seconds
+#define QUALITY_HIGH 0.85         // Share of a budget past which quality is lowered
+#define QUALITY_LOW 0.5           // Share of a budget a raised quality must be expected to stay under
+#define QUALITY_PATIENCE 3        // Windows of headroom in a row before quality is raised
+#define QUALITY_MAX_PATIENCE 24   // Most windows of headroom ever waited for
+#define QUALITY_COLOR_COST 2.0    // Expected growth of the bytes of a frame for one richer colour mode
+
+/**
+ * @brief Trades image quality for frame rate when rendering or the terminal link falls behind.
+ * The controller watches windows of QUALITY_WINDOW frames: the time spent
+ * rendering them, and the bytes the presenter wrote with the time it spent
+ * blocked writing them. Writes only block for long once the link to the
+ * terminal is saturated, so only such windows measure what it carries; in
+ * between, the estimate grows slowly in case the link got faster. When a frame takes more than QUALITY_HIGH of its bytes
+ * the colour depth drops first, then the render resolution; when rendering
+ * takes more than QUALITY_HIGH of the frame time the resolution drops.
+ * Quality only comes back after QUALITY_PATIENCE windows in a row of
+ * headroom, and only if the richer frames are expected to stay under
+ * QUALITY_LOW of the budget, so the controller does not oscillate between
+ * two settings. Whatever the quality, frames are paced so that their bytes
+ * stay within the budget.
+ */
+class QualityController {
+ private:
+  double _frameTime;                ///< Target seconds per frame
+  double _byteRate;                 ///< Most bytes per second to send, 0 for no limit but the link
+  ColorMode _maxColor;              ///< Richest colour mode allowed
+  ColorMode _color;                 ///< Colour mode frames are drawn in
+  int _scale = 1;                   ///< Render scale frames are traced at
+  double _interval;                 ///< Seconds from the start of a frame to the start of the next
+  int _frames = 0;                  ///< Frames measured in the current window
+  double _renderTime = 0;           ///< Seconds spent rendering the frames of the current window
+  unsigned long _presented = 0;     ///< Frames presented before the current window
+  unsigned long long _bytes = 0;    ///< Bytes written before the current window
+  double _writeTime = 0;            ///< Seconds spent writing before the current window
+  int _headroom = 0;                ///< Windows in a row that had room for more quality
+  int _patience = QUALITY_PATIENCE; ///< Windows of headroom needed before quality is raised
+  int _sinceRaise = QUALITY_MAX_PATIENCE; ///< Windows since quality was last raised and kept
+  bool _settling = true;            ///< Set while a window starting with a full redraw runs
+
+ public:
+  /**
+   * @brief Constructs a controller starting at full quality.
+   * @param fps The frame rate to aim for.
+   * @param byteRate The most bytes per second to send, 0 to only respect the link.
+   * @param maxColor The richest colour mode to draw in.
+   */
+  QualityController(double fps, double byteRate, ColorMode maxColor);
+
+  /**
+   * @brief Accounts for one rendered frame and, at the end of a window, adjusts the quality.
+   * @param renderSeconds The time spent rendering the frame.
+   * @param presenter The presenter the frames are submitted to.
+   * @return True if the render scale or the colour mode changed.
+   */
+  bool update(double renderSeconds, const Presenter &presenter);
+
+  /**
+   * @brief Returns the render scale frames should be traced at.
+   * @return The samples along each axis sharing one ray.
+   */
+  int renderScale() const { return _scale; }
+
+  /**
+   * @brief Returns the colour mode frames should be drawn in.
+   * @return The colour mode.
+   */
+  ColorMode colorMode() const { return _color; }
+
+  /**
+   * @brief Returns the time from the start of one frame to the start of the next.
+   * @return The frame interval in seconds.
+   */
+  double frameInterval() const { return _interval; }
+};
+
+#endif //_QUALITY_CONTROLLER_H_
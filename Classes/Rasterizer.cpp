@@ -0,0 +1,227 @@
+#include <algorithm>
+#include <cmath>
+#include "Rasterizer.h"
+
+// Constructs a rasterizer binning triangles into tiles of the given size
+Rasterizer::Rasterizer(int tileRows, int tileCols) : _tileRows(tileRows), _tileCols(tileCols) {}
+
+// Projects every triangle of a mesh and bins it into the tiles it overlaps
+void Rasterizer::setup(const Mesh &mesh, const Canvas &canvas, int subRows, int subCols, int scale,
+                       const Eigen::Vector3d &origin, const Eigen::Vector3d &point0, const Eigen::Vector3d &vec1,
+                       const Eigen::Vector3d &vec2, ThreadPool &pool) {
+  _subRows = subRows;
+  _subCols = subCols;
+  _scale = scale;
+  int rows = (std::max(0, static_cast<int>(canvas.rows())) * subRows + scale - 1) / scale;
+  int cols = (std::max(0, static_cast<int>(canvas.cols())) * subCols + scale - 1) / scale;
+  if (rows != _rows || cols != _cols) {
+    _rows = rows;
+    _cols = cols;
+    _stride = cacheStride<Hit>(cols);
+    _hits.assign(static_cast<size_t>(rows) * _stride, Hit());
+  }
+  _tilesX = (cols + _tileCols - 1) / _tileCols;
+  unsigned int tiles = _tilesX * ((rows + _tileRows - 1) / _tileRows);
+
+  // Dividing by the squared lengths turns a dot product into a coordinate along each axis
+  Eigen::Vector3d forward = point0 - origin;
+  Eigen::Vector3d toDepth = forward / forward.squaredNorm();
+  Eigen::Vector3d toY = vec1 / vec1.squaredNorm();
+  Eigen::Vector3d toX = vec2 / vec2.squaredNorm();
+
+  // Project every vertex once, as most are shared by several triangles
+  _camera.resize(mesh.vertexCount());
+  _screen.resize(mesh.vertexCount());
+  unsigned int vertexChunks = (mesh.vertexCount() + RASTER_CHUNK - 1) / RASTER_CHUNK;
+  pool.parallelFor(vertexChunks, [&](unsigned int c, unsigned int) {
+    unsigned int end = std::min<unsigned int>(mesh.vertexCount(), (c + 1) * RASTER_CHUNK);
+    for (unsigned int v = c * RASTER_CHUNK; v < end; v++) {
+      // Image-plane coordinates scaled by depth, so clipping stays linear
+      Eigen::Vector3d d = mesh.position(v) - origin;
+      _camera[v] = Eigen::Vector3d(d.dot(toX), d.dot(toY), d.dot(toDepth));
+      _screen[v] = project(canvas, _camera[v]);
+    }
+  });
+
+  unsigned int chunks = (mesh.triangleCount() + RASTER_CHUNK - 1) / RASTER_CHUNK;
+  _chunks.resize(chunks);
+  pool.parallelFor(chunks, [&](unsigned int c, unsigned int) {
+    Chunk &chunk = _chunks[c];
+    unsigned int end = std::min<unsigned int>(mesh.triangleCount(), (c + 1) * RASTER_CHUNK);
+    chunk.setups.clear();
+    chunk.setups.reserve(2 * (end - c * RASTER_CHUNK));  // Clipping makes at most two of a triangle
+    // Bins past the tile count are kept for when the canvas grows back
+    if (chunk.bins.size() < tiles) {
+      chunk.bins.resize(tiles);
+    }
+    for (unsigned int tile = 0; tile < tiles; tile++) {
+      chunk.bins[tile].clear();
+    }
+
+    for (unsigned int t = c * RASTER_CHUNK; t < end; t++) {
+      setupTriangle(chunk, canvas, t, mesh.getTriangle(t));
+    }
+    for (Setup &s : chunk.setups) {
+      s.face = mesh.triangleFace(s.triangle);
+    }
+  });
+}
+
+// Maps a camera-space point to sample space
+Eigen::Vector3d Rasterizer::project(const Canvas &canvas, const Eigen::Vector3d &camera) const {
+  // The cell mapping is affine, so it follows the perspective divide
+  double w = camera.z();
+  double x = canvas.getCanvasX(static_cast<float>(camera.x() / w));
+  double y = canvas.getCanvasY(static_cast<float>(camera.y() / w));
+  // A cell's samples are spread evenly around the point a single sample would take
+  return Eigen::Vector3d((x + 0.5) * _subCols / _scale - 0.5, (y + 0.5) * _subRows / _scale - 0.5, w);
+}
+
+// Projects, clips and bins one mesh triangle
+void Rasterizer::setupTriangle(Chunk &chunk, const Canvas &canvas, unsigned int index, const triangle &tri) {
+  const Eigen::Vector2d corners[3] = {Eigen::Vector2d(0, 0), Eigen::Vector2d(1, 0), Eigen::Vector2d(0, 1)};
+  if (_camera[tri[0]].z() >= RASTER_NEAR && _camera[tri[1]].z() >= RASTER_NEAR &&
+      _camera[tri[2]].z() >= RASTER_NEAR) {
+    const Eigen::Vector3d screen[3] = {_screen[tri[0]], _screen[tri[1]], _screen[tri[2]]};
+    addSetup(chunk, index, screen, corners);
+    return;
+  }
+
+  // Clip against the near plane, carrying the barycentrics of the mesh triangle along
+  Eigen::Vector3d screen[4];
+  Eigen::Vector2d bary[4];
+  int count = 0;
+  for (int k = 0; k < 3; k++) {
+    const Eigen::Vector3d &p = _camera[tri[k]], &q = _camera[tri[(k + 1) % 3]];
+    bool pIn = p.z() >= RASTER_NEAR, qIn = q.z() >= RASTER_NEAR;
+    if (pIn) {
+      screen[count] = _screen[tri[k]];
+      bary[count++] = corners[k];
+    }
+    if (pIn != qIn) {
+      double s = (RASTER_NEAR - p.z()) / (q.z() - p.z());
+      screen[count] = project(canvas, p + s * (q - p));
+      bary[count++] = corners[k] + s * (corners[(k + 1) % 3] - corners[k]);
+    }
+  }
+
+  // Clipping leaves nothing, a triangle or a quad, drawn as a fan
+  for (int k = 1; k + 1 < count; k++) {
+    const Eigen::Vector3d fan[3] = {screen[0], screen[k], screen[k + 1]};
+    const Eigen::Vector2d fanBary[3] = {bary[0], bary[k], bary[k + 1]};
+    addSetup(chunk, index, fan, fanBary);
+  }
+}
+
+// Adds one projected triangle that lies entirely past the near plane
+void Rasterizer::addSetup(Chunk &chunk, unsigned int index, const Eigen::Vector3d screen[3],
+                          const Eigen::Vector2d bary[3]) {
+  Setup s;
+  double minCol = std::min({screen[0].x(), screen[1].x(), screen[2].x()});
+  double maxCol = std::max({screen[0].x(), screen[1].x(), screen[2].x()});
+  double minRow = std::min({screen[0].y(), screen[1].y(), screen[2].y()});
+  double maxRow = std::max({screen[0].y(), screen[1].y(), screen[2].y()});
+  s.colMin = static_cast<int>(std::max(0.0, std::ceil(minCol)));
+  s.colMax = static_cast<int>(std::min(_cols - 1.0, std::floor(maxCol)));
+  s.rowMin = static_cast<int>(std::max(0.0, std::ceil(minRow)));
+  s.rowMax = static_cast<int>(std::min(_rows - 1.0, std::floor(maxRow)));
+  if (s.colMin > s.colMax || s.rowMin > s.rowMax) {
+    return;  // Off the canvas or between sample points
+  }
+
+  // Edge k faces vertex k, so it evaluates to twice the area there and to zero on the other two
+  for (int k = 0; k < 3; k++) {
+    const Eigen::Vector3d &p = screen[(k + 1) % 3], &q = screen[(k + 2) % 3];
+    s.a[k] = p.y() - q.y();
+    s.b[k] = q.x() - p.x();
+    s.c[k] = p.x() * q.y() - q.x() * p.y();
+  }
+  double area = s.a[0] * screen[0].x() + s.b[0] * screen[0].y() + s.c[0];
+  if (area == 0) {
+    return;  // Seen edge-on
+  }
+  // Both windings are drawn, as the ray casters do
+  double sign = area > 0 ? 1 : -1;
+  for (int k = 0; k < 3; k++) {
+    s.a[k] *= sign;
+    s.b[k] *= sign;
+    s.c[k] *= sign;
+    // A shared edge is negated in the neighbouring triangle, so exactly one of the two owns it
+    s.topLeft[k] = s.a[k] > 0 || (s.a[k] == 0 && s.b[k] > 0);
+  }
+  s.invArea = 1 / (area * sign);
+
+  // Depth and barycentrics interpolate linearly in sample space once divided by depth
+  for (int k = 0; k < 3; k++) {
+    s.invW[k] = 1 / screen[k].z();
+    s.uW[k] = bary[k].x() * s.invW[k];
+    s.vW[k] = bary[k].y() * s.invW[k];
+  }
+  s.triangle = index;
+  s.face = 0;  // Filled in by setup(), which has the mesh
+
+  unsigned int setup = static_cast<unsigned int>(chunk.setups.size());
+  chunk.setups.push_back(s);
+  for (int ty = s.rowMin / _tileRows; ty <= s.rowMax / _tileRows; ty++) {
+    for (int tx = s.colMin / _tileCols; tx <= s.colMax / _tileCols; tx++) {
+      chunk.bins[ty * _tilesX + tx].push_back(setup);
+    }
+  }
+}
+
+// Fills the samples of one tile with the closest surface
+void Rasterizer::rasterTile(int row0, int col0) {
+  int rowEnd = std::min(row0 + _tileRows, _rows);
+  int colEnd = std::min(col0 + _tileCols, _cols);
+  unsigned int tile = row0 / _tileRows * _tilesX + col0 / _tileCols;
+
+  for (int i = row0; i < rowEnd; i++) {
+    Hit *hits = &_hits[static_cast<size_t>(i) * _stride];
+    for (int j = col0; j < colEnd; j++) {
+      hits[j] = Hit();
+      hits[j].t = INFINITY;
+    }
+  }
+
+  for (const Chunk &chunk : _chunks) {
+    for (unsigned int index : chunk.bins[tile]) {
+      const Setup &s = chunk.setups[index];
+      int r0 = std::max(s.rowMin, row0), r1 = std::min(s.rowMax, rowEnd - 1);
+      int c0 = std::max(s.colMin, col0), c1 = std::min(s.colMax, colEnd - 1);
+
+      for (int i = r0; i <= r1; i++) {
+        Hit *hits = &_hits[static_cast<size_t>(i) * _stride];
+        // Evaluate the edges once per row, then step them along it
+        double e[3];
+        for (int k = 0; k < 3; k++) {
+          e[k] = s.a[k] * c0 + s.b[k] * i + s.c[k];
+        }
+        for (int j = c0; j <= c1; j++) {
+          bool inside = true;
+          for (int k = 0; k < 3; k++) {
+            inside &= e[k] > 0 || (e[k] == 0 && s.topLeft[k]);
+          }
+          if (inside) {
+            double l0 = e[0] * s.invArea, l1 = e[1] * s.invArea, l2 = e[2] * s.invArea;
+            double w = 1 / (l0 * s.invW[0] + l1 * s.invW[1] + l2 * s.invW[2]);
+            if (w < hits[j].t) {
+              hits[j].t = w;
+              hits[j].u = (l0 * s.uW[0] + l1 * s.uW[1] + l2 * s.uW[2]) * w;
+              hits[j].v = (l0 * s.vW[0] + l1 * s.vW[1] + l2 * s.vW[2]) * w;
+              hits[j].triangle = s.triangle;
+              hits[j].face = s.face;
+            }
+          }
+          for (int k = 0; k < 3; k++) {
+            e[k] += s.a[k];
+          }
+        }
+      }
+    }
+  }
+}
+
+// Retrieves the closest surface of a sample
+const Hit &Rasterizer::hit(int i, int j) const {
+  return _hits[static_cast<size_t>(i) * _stride + j];
+}
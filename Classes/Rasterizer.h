@@ -0,0 +1,138 @@
+#ifndef _RASTERIZER_H_
+#define _RASTERIZER_H_
+
+#include <vector>
+#include <Eigen/Dense>
+#include "Mesh.h"
+#include "Hit.h"
+#include "Canvas.h"
+#include "CacheAligned.h"
+#include "ThreadPool.h"
+
+#define RASTER_NEAR 1e-3     // Closest depth drawn, in units of the camera's forward vector
+#define RASTER_CHUNK 4096    // Triangles set up by one task
+
+/**
+ * @brief Scanline z-buffer rasterizer for the primary visibility of a pinhole camera.
+ * Triangles are projected into Canvas cell space, or a finer grid of samples
+ * within the cells, clipped against the near plane and binned into tiles.
+ * Each tile is then filled with incrementally evaluated edge functions,
+ * keeping the closest surface of every sample. The result of a sample is the
+ * same Hit a ray through it would report, so the camera shades both paths
+ * alike.
+ */
+class Rasterizer {
+ private:
+  /**
+   * @brief A projected triangle, ready to be scanned.
+   */
+  struct Setup {
+    double a[3], b[3], c[3];  ///< Edge functions a*col + b*row + c, positive inside
+    bool topLeft[3];          ///< Whether samples exactly on an edge belong to this triangle
+    double invW[3];           ///< Inverse depth at each vertex
+    double uW[3];             ///< Barycentric u over depth at each vertex
+    double vW[3];             ///< Barycentric v over depth at each vertex
+    double invArea;           ///< Inverse of twice the projected area
+    int rowMin, rowMax;       ///< Rows covered by the bounding box, clamped to the canvas
+    int colMin, colMax;       ///< Columns covered by the bounding box, clamped to the canvas
+    unsigned int triangle;    ///< Mesh triangle the setup came from
+    unsigned int face;        ///< Mesh face the triangle belongs to
+  };
+
+  /**
+   * @brief Triangles set up by one task, with their tile bins.
+   */
+  struct Chunk {
+    std::vector<Setup> setups;              ///< Projected triangles of the chunk
+    std::vector<std::vector<unsigned int>> bins;  ///< Setups overlapping each tile
+  };
+
+  int _tileRows;                    ///< Rows of samples in a tile
+  int _tileCols;                    ///< Columns of samples in a tile
+  int _subRows = 1;                 ///< Sample rows in every canvas cell
+  int _subCols = 1;                 ///< Sample columns in every canvas cell
+  int _scale = 1;                   ///< Cell samples along each axis covered by one raster sample
+  int _rows = 0;                    ///< Rows of samples being drawn
+  int _cols = 0;                    ///< Columns of samples being drawn
+  int _tilesX = 0;                  ///< Tiles across the canvas
+  int _stride = 0;                  ///< Row stride of _hits
+  CacheAlignedVector<Hit> _hits;    ///< Closest surface of every sample, t = INFINITY where empty
+  std::vector<Chunk> _chunks;       ///< Set-up triangles, reused from frame to frame
+  std::vector<Eigen::Vector3d> _camera;  ///< Mesh vertices in camera space: NDC x and y times depth, then depth
+  std::vector<Eigen::Vector3d> _screen;  ///< Mesh vertices in sample space: column, row and depth
+
+  /**
+   * @brief Maps a camera-space point to sample space.
+   * @param canvas The canvas defining the cells.
+   * @param camera The point in camera space, in front of the camera.
+   * @return The sample column, row and depth of the point.
+   */
+  Eigen::Vector3d project(const Canvas &canvas, const Eigen::Vector3d &camera) const;
+
+  /**
+   * @brief Projects, clips and bins one mesh triangle.
+   * @param chunk The chunk receiving the setups.
+   * @param canvas The canvas defining the cells.
+   * @param index The index of the triangle in the mesh.
+   * @param tri The vertex indices of the triangle.
+   */
+  void setupTriangle(Chunk &chunk, const Canvas &canvas, unsigned int index, const triangle &tri);
+
+  /**
+   * @brief Adds one projected triangle that lies entirely past the near plane.
+   * @param chunk The chunk receiving the setup.
+   * @param index The index of the triangle in the mesh.
+   * @param screen The vertices in sample space: column, row and depth.
+   * @param bary The barycentric u and v of the vertices in the mesh triangle.
+   */
+  void addSetup(Chunk &chunk, unsigned int index, const Eigen::Vector3d screen[3], const Eigen::Vector2d bary[3]);
+
+ public:
+  /**
+   * @brief Constructs a rasterizer binning triangles into tiles of the given size.
+   * @param tileRows The rows of samples in a tile.
+   * @param tileCols The columns of samples in a tile.
+   */
+  Rasterizer(int tileRows, int tileCols);
+
+  /**
+   * @brief Projects every triangle of a mesh and bins it into the tiles it overlaps.
+   * The camera is given in the mesh's space: the ray of cell (i, j) is
+   * point0 + NDCy(i) * vec1 + NDCx(j) * vec2 - origin, with vec1 and vec2
+   * orthogonal to point0 - origin. Every cell is split into subRows x subCols
+   * samples centred on the cell's own sample point, and blocks of
+   * scale x scale of those are drawn as one sample at the block's centre;
+   * those are what the tiles, rows and columns below count.
+   * @param mesh The mesh to draw.
+   * @param canvas The canvas defining the cells.
+   * @param subRows The sample rows in every cell.
+   * @param subCols The sample columns in every cell.
+   * @param scale The cell samples along each axis drawn as one, 1 for all of them.
+   * @param origin The camera position.
+   * @param point0 The centre of the image plane.
+   * @param vec1 The image plane's vertical axis.
+   * @param vec2 The image plane's horizontal axis.
+   * @param pool The threads setting up the triangles.
+   */
+  void setup(const Mesh &mesh, const Canvas &canvas, int subRows, int subCols, int scale,
+             const Eigen::Vector3d &origin, const Eigen::Vector3d &point0, const Eigen::Vector3d &vec1,
+             const Eigen::Vector3d &vec2, ThreadPool &pool);
+
+  /**
+   * @brief Fills the samples of one tile with the closest surface.
+   * Tiles cover disjoint samples, so any number of them can be drawn at once.
+   * @param row0 The first sample row of the tile.
+   * @param col0 The first sample column of the tile.
+   */
+  void rasterTile(int row0, int col0);
+
+  /**
+   * @brief Retrieves the closest surface of a sample.
+   * @param i The sample row.
+   * @param j The sample column.
+   * @return The hit a ray through the sample would report, t = INFINITY if none.
+   */
+  const Hit &hit(int i, int j) const;
+};
+
+#endif //_RASTERIZER_H_
@@ -0,0 +1,45 @@
+#include <algorithm>
+#include "RayPacket.h"
+
+// Starts a new packet
+void RayPacket::reset(const Eigen::Vector3d &orig) {
+  origin = orig;
+  active = 0;
+  hits = 0;
+  for (int r = 0; r < PACKET_LANES; r++) {
+    dir[0][r] = dir[1][r] = dir[2][r] = 0;
+    t[r] = 0;  // Unused lanes never hit
+    u[r] = v[r] = 0;
+    triangle[r] = 0;
+  }
+}
+
+// Adds a ray to the packet
+void RayPacket::setRay(unsigned int ray, const Eigen::Vector3d &direction, float tMax) {
+  for (int a = 0; a < 3; a++) {
+    dir[a][ray] = static_cast<float>(direction[a]);
+  }
+  t[ray] = tMax;
+  active |= uint64_t(1) << ray;
+}
+
+// Computes the inverse directions and their intervals once every ray is set
+void RayPacket::prepare() {
+  for (int a = 0; a < 3; a++) {
+    invMin[a] = INFINITY;
+    invMax[a] = -INFINITY;
+    bool positive = false, negative = false;
+    for (int r = 0; r < PACKET_LANES; r++) {
+      invDir[a][r] = 1.0f / dir[a][r];
+      if (!(active >> r & 1)) {
+        continue;
+      }
+      invMin[a] = std::min(invMin[a], invDir[a][r]);
+      invMax[a] = std::max(invMax[a], invDir[a][r]);
+      positive |= dir[a][r] > 0;
+      negative |= dir[a][r] < 0;
+    }
+    // A packet straddling the axis has an unbounded interval and is not used by the frustum test
+    coherent[a] = active != 0 && positive != negative;
+  }
+}
@@ -0,0 +1,55 @@
+#ifndef _RAY_PACKET_H_
+#define _RAY_PACKET_H_
+
+#include <cstdint>
+#include <Eigen/Dense>
+#include "Simd.h"
+
+#define PACKET_SIZE 4  // Cells per side of a packet: 2, 4 or 8
+#define PACKET_RAYS (PACKET_SIZE * PACKET_SIZE)  // Rays in a packet, at most 64
+#define PACKET_LANES ((PACKET_RAYS + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH)  // Rays rounded up to whole vectors
+#define PACKET_SPLIT 2  // Packets with this few active rays left finish the subtree ray by ray
+
+/**
+ * @brief A block of coherent rays sharing one origin, traced together.
+ * Directions are stored per axis so that SIMD_WIDTH rays fill one vector.
+ * Lanes past PACKET_RAYS and rays left out of `active` start with t = 0
+ * and can therefore never report a hit.
+ */
+struct RayPacket {
+  Eigen::Vector3d origin;          ///< Origin shared by every ray
+  float dir[3][PACKET_LANES];      ///< Directions, per axis then per ray
+  float invDir[3][PACKET_LANES];   ///< Component-wise inverse of the directions
+  float t[PACKET_LANES];           ///< Far end of each ray's interval, shrunk to the closest hit
+  float u[PACKET_LANES];           ///< Barycentric of the closest hit along e1
+  float v[PACKET_LANES];           ///< Barycentric of the closest hit along e2
+  unsigned int triangle[PACKET_LANES];  ///< Triangle of the closest hit
+  uint64_t active = 0;             ///< Rays taking part in the trace
+  uint64_t hits = 0;               ///< Rays that hit something
+
+  // Interval of the inverse directions over the packet, for the frustum test
+  float invMin[3];                 ///< Smallest inverse direction per axis
+  float invMax[3];                 ///< Largest inverse direction per axis
+  bool coherent[3];                ///< Whether every ray points the same way along the axis
+
+  /**
+   * @brief Starts a new packet.
+   * @param orig The origin shared by every ray.
+   */
+  void reset(const Eigen::Vector3d &orig);
+
+  /**
+   * @brief Adds a ray to the packet.
+   * @param ray The index of the ray, in [0, PACKET_RAYS).
+   * @param direction The direction of the ray.
+   * @param tMax The far end of the ray's interval.
+   */
+  void setRay(unsigned int ray, const Eigen::Vector3d &direction, float tMax = INFINITY);
+
+  /**
+   * @brief Computes the inverse directions and their intervals once every ray is set.
+   */
+  void prepare();
+};
+
+#endif //_RAY_PACKET_H_
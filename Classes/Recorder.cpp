@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "Recorder.h"
+
+// Creates a recording, replacing any file at the path
+Recorder::Recorder(const std::string &path) : _offset(sizeof(RecordHeader)) {
+  _fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (_fd == -1) {
+    std::cerr << "Unable to create recording " << path << std::endl;
+    return;
+  }
+  // Zeros mark the header as unfinished until the destructor fills it in
+  RecordHeader header = {};
+  std::memcpy(header.magic, RECORD_MAGIC, sizeof(header.magic));
+  append(&header, sizeof(header));
+}
+
+// Writes the frame index and closes the recording
+Recorder::~Recorder() {
+  if (_fd == -1) {
+    return;
+  }
+  if (!_failed) {
+    RecordHeader header = {};
+    std::memcpy(header.magic, RECORD_MAGIC, sizeof(header.magic));
+    header.frames = _index.size();
+    header.indexOffset = _offset;
+    append(_index.data(), _index.size() * sizeof(RecordIndex));
+    if (!_failed && pwrite(_fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))) {
+      std::cerr << "Failed to finish the recording." << std::endl;
+    }
+  }
+  close(_fd);
+}
+
+// Checks whether the recording could be created
+bool Recorder::isOpen() const {
+  return _fd != -1;
+}
+
+// Writes bytes at the end of the file, remembering a failure
+void Recorder::append(const void *data, size_t size, const void *more, size_t moreSize) {
+  struct iovec parts[2] = {{const_cast<void *>(data), size}, {const_cast<void *>(more), moreSize}};
+  int first = 0;
+  while (!_failed && first < 2) {
+    ssize_t written = writev(_fd, parts + first, 2 - first);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      std::cerr << "Failed to write the recording." << std::endl;
+      _failed = true;
+      break;
+    }
+    while (first < 2 && static_cast<size_t>(written) >= parts[first].iov_len) {
+      written -= parts[first].iov_len;
+      first++;
+    }
+    if (first < 2) {
+      parts[first].iov_base = static_cast<char *>(parts[first].iov_base) + written;
+      parts[first].iov_len -= written;
+    }
+  }
+}
+
+// Appends one frame, timed from the first one
+void Recorder::add(const Canvas &canvas) {
+  if (_fd == -1 || _failed) {
+    return;
+  }
+  auto now = std::chrono::steady_clock::now();
+  if (_index.empty()) {
+    _start = now;
+  }
+
+  const int rows = std::max(0, static_cast<int>(canvas.rows()));
+  const int cols = std::max(0, static_cast<int>(canvas.cols()));
+  const int cellBytes = canvas.cellBytes();
+  const uint32_t *colors = canvas.colors();
+  const uint32_t *previousColors = _previous.colors();
+  bool keyframe = !canvas.sameLayout(_previous) || _sinceKeyframe >= RECORD_KEYFRAME;
+  _sinceKeyframe = keyframe ? 1 : _sinceKeyframe + 1;
+
+  // Store the rows that changed since the last frame, or all of them in a keyframe
+  RecordFrame frame = {};
+  _frame.clear();
+  for (int r = 0; r < rows; r++) {
+    const char *cells = canvas.data() + static_cast<size_t>(r) * canvas.stride();
+    const char *rowColors =
+        colors ? reinterpret_cast<const char *>(colors + 2 * static_cast<size_t>(r) * cols) : nullptr;
+    if (!keyframe &&
+        std::memcmp(cells, _previous.data() + static_cast<size_t>(r) * canvas.stride(), cols * cellBytes) == 0 &&
+        (!colors || std::memcmp(rowColors, previousColors + 2 * static_cast<size_t>(r) * cols,
+                                cols * 2 * sizeof(uint32_t)) == 0)) {
+      continue;
+    }
+    uint16_t row = static_cast<uint16_t>(r);
+    _frame.append(reinterpret_cast<const char *>(&row), sizeof(row));
+    packRuns(_frame, cells, cols, cellBytes);
+    if (colors) {
+      packRuns(_frame, rowColors, cols, 2 * sizeof(uint32_t));
+    }
+    frame.changedRows++;
+  }
+  frame.micros = std::chrono::duration_cast<std::chrono::microseconds>(now - _start).count();
+  frame.size = static_cast<uint32_t>(_frame.size());
+  frame.rows = static_cast<uint16_t>(rows);
+  frame.cols = static_cast<uint16_t>(cols);
+  frame.cellBytes = static_cast<uint8_t>(cellBytes);
+  frame.colorMode = static_cast<uint8_t>(canvas.colorMode());
+  frame.keyframe = keyframe;
+
+  _index.push_back({_offset, frame.micros});
+  append(&frame, sizeof(frame), _frame.data(), _frame.size());
+  _offset += sizeof(frame) + _frame.size();
+  _previous = canvas;  // Same layout as last time, so this copies into the existing buffers
+}
+
+// Appends cells to a buffer as runs
+void Recorder::packRuns(std::string &out, const char *cells, int count, int unit) {
+  auto same = [&](int a, int b) { return std::memcmp(cells + a * unit, cells + b * unit, unit) == 0; };
+  // Whether a repeat run worth its control byte starts at a cell
+  auto repeats = [&](int a) {
+    if (a + RECORD_REPEAT > count) {
+      return false;
+    }
+    for (int k = 1; k < RECORD_REPEAT; k++) {
+      if (!same(a, a + k)) {
+        return false;
+      }
+    }
+    return true;
+  };
+  const int longest = 255 - RECORD_LITERAL + RECORD_REPEAT;
+  int i = 0;
+  while (i < count) {
+    int run = 1;
+    while (i + run < count && run < longest && same(i, i + run)) {
+      run++;
+    }
+    if (run >= RECORD_REPEAT) {
+      out.push_back(static_cast<char>(run - RECORD_REPEAT + RECORD_LITERAL));
+      out.append(cells + i * unit, unit);
+      i += run;
+      continue;
+    }
+
+    // Literal cells up to the next repeat worth its control byte
+    int end = i + 1;
+    while (end < count && end - i < RECORD_LITERAL && !repeats(end)) {
+      end++;
+    }
+    out.push_back(static_cast<char>(end - i - 1));
+    out.append(cells + i * unit, static_cast<size_t>(end - i) * unit);
+    i = end;
+  }
+}
+
+// Reads runs back into cells
+const char *Recorder::unpackRuns(const char *in, const char *end, char *cells, int count, int unit) {
+  int i = 0;
+  while (i < count) {
+    if (in >= end) {
+      return nullptr;
+    }
+    int control = static_cast<uint8_t>(*in++);
+    if (control < RECORD_LITERAL) {
+      int literal = control + 1;
+      if (i + literal > count || end - in < static_cast<ptrdiff_t>(literal) * unit) {
+        return nullptr;
+      }
+      std::memcpy(cells + static_cast<size_t>(i) * unit, in, static_cast<size_t>(literal) * unit);
+      in += static_cast<size_t>(literal) * unit;
+      i += literal;
+    } else {
+      int run = control - RECORD_LITERAL + RECORD_REPEAT;
+      if (i + run > count || end - in < unit) {
+        return nullptr;
+      }
+      for (int k = 0; k < run; k++) {
+        std::memcpy(cells + static_cast<size_t>(i + k) * unit, in, unit);
+      }
+      in += unit;
+      i += run;
+    }
+  }
+  return in;
+}
@@ -0,0 +1,132 @@
+#ifndef _RECORDER_H_
+#define _RECORDER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Canvas.h"
+
+#define RECORD_MAGIC "CAVEREC1"  // First bytes of a recording, with the format version
+#define RECORD_KEYFRAME 120      // Frames between keyframes, bounding the frames a seek replays
+#define RECORD_LITERAL 128       // Most cells in one literal run
+#define RECORD_REPEAT 3          // Fewest equal cells stored as a repeat run
+
+/**
+ * @brief Fixed header at the start of a recording.
+ * The frame count and index offset are only filled in once recording
+ * ends; a recording cut short keeps zeros there and is read by scanning
+ * its frames instead.
+ */
+struct RecordHeader {
+  char magic[8];         ///< RECORD_MAGIC, without its terminator
+  uint64_t frames;       ///< Frames in the recording
+  uint64_t indexOffset;  ///< Where the frame index starts, 0 if it was never written
+};
+
+/**
+ * @brief Entry of the frame index at the end of a recording.
+ */
+struct RecordIndex {
+  uint64_t offset;  ///< Where the frame's RecordFrame starts
+  uint64_t micros;  ///< Microseconds from the first frame to this one
+};
+
+/**
+ * @brief Header of every frame, followed by size bytes of changed rows.
+ * Each changed row is its uint16_t row number, then its cells and, on a
+ * coloured canvas, its foreground and background pairs, both as runs. A
+ * control byte n below RECORD_LITERAL is followed by n + 1 literal cells;
+ * from RECORD_LITERAL on, by one cell repeated
+ * n - RECORD_LITERAL + RECORD_REPEAT times.
+ */
+struct RecordFrame {
+  uint64_t micros;       ///< Microseconds from the first frame to this one
+  uint32_t size;         ///< Bytes of changed rows after the header
+  uint16_t rows;         ///< Rows of the canvas
+  uint16_t cols;         ///< Columns of the canvas
+  uint16_t changedRows;  ///< Rows stored in the frame
+  uint8_t cellBytes;     ///< Bytes of every cell
+  uint8_t colorMode;     ///< ColorMode of the canvas
+  uint8_t keyframe;      ///< 1 if every row is stored, so the frame stands on its own
+  uint8_t pad[3];        ///< Zero
+};
+
+/**
+ * @brief Appends the frames of a Canvas to a compact recording file.
+ * Every RECORD_KEYFRAME frames, and whenever the canvas layout changes,
+ * a keyframe stores every row; the frames in between only store the rows
+ * that differ from the frame before, run-length encoded. When recording
+ * ends, an index of every frame's offset and time is appended so a player
+ * can seek without reading the frames. Numbers are stored in host byte
+ * order.
+ */
+class Recorder {
+ private:
+  int _fd;                          ///< File the frames are written to, -1 if it could not be opened
+  bool _failed = false;             ///< Set once a write failed, after which nothing more is written
+  Canvas _previous{0, 0};           ///< Last frame recorded, for the row deltas
+  unsigned int _sinceKeyframe = 0;  ///< Frames recorded since the last keyframe
+  std::string _frame;               ///< Changed rows of the frame being recorded, reused from frame to frame
+  std::vector<RecordIndex> _index;  ///< Offset and time of every frame recorded
+  uint64_t _offset;                 ///< Where the next frame goes in the file
+  std::chrono::steady_clock::time_point _start; ///< When the first frame was recorded
+
+  /**
+   * @brief Writes bytes at the end of the file, remembering a failure.
+   * @param data The bytes.
+   * @param size The number of bytes.
+   * @param more Bytes written right after them, in the same call.
+   * @param moreSize The number of those bytes.
+   */
+  void append(const void *data, size_t size, const void *more = nullptr, size_t moreSize = 0);
+
+ public:
+  /**
+   * @brief Creates a recording, replacing any file at the path.
+   * @param path The path of the recording.
+   */
+  explicit Recorder(const std::string &path);
+
+  /**
+   * @brief Writes the frame index and closes the recording.
+   */
+  ~Recorder();
+
+  Recorder(const Recorder &) = delete;
+  Recorder &operator=(const Recorder &) = delete;
+
+  /**
+   * @brief Checks whether the recording could be created.
+   * @return True if frames can be added.
+   */
+  bool isOpen() const;
+
+  /**
+   * @brief Appends one frame, timed from the first one.
+   * @param canvas The finished canvas.
+   */
+  void add(const Canvas &canvas);
+
+  /**
+   * @brief Appends cells to a buffer as runs.
+   * @param out The buffer.
+   * @param cells The first cell.
+   * @param count The number of cells.
+   * @param unit The bytes of every cell.
+   */
+  static void packRuns(std::string &out, const char *cells, int count, int unit);
+
+  /**
+   * @brief Reads runs back into cells.
+   * @param in The first byte of the runs.
+   * @param end One past the last byte the runs may take.
+   * @param cells Receives the cells.
+   * @param count The number of cells.
+   * @param unit The bytes of every cell.
+   * @return One past the last byte read, or nullptr if the runs are corrupt.
+   */
+  static const char *unpackRuns(const char *in, const char *end, char *cells, int count, int unit);
+};
+
+#endif //_RECORDER_H_
@@ -0,0 +1,320 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "RenderServer.h"
+
+// Fills in the address of a socket path
+static bool socketAddress(const std::string &path, sockaddr_un &address) {
+  address = {};
+  address.sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+    std::cerr << "Invalid socket path " << path << std::endl;
+    return false;
+  }
+  std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+  return true;
+}
+
+// Starts listening for clients
+RenderServer::RenderServer(const Model &model, const std::string &path)
+    : _model(model), _path(path), _pool(ThreadPool::shared()) {
+  sockaddr_un address;
+  if (!socketAddress(path, address)) {
+    return;
+  }
+
+  // A socket nobody answers on is left over from a server that did not shut down
+  struct stat info;
+  if (lstat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) {
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    bool live = probe != -1 && connect(probe, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0;
+    if (probe != -1) {
+      ::close(probe);
+    }
+    if (live) {
+      std::cerr << "A server is already listening on " << path << std::endl;
+      return;
+    }
+    unlink(path.c_str());
+  }
+
+  _listen = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+  if (_listen == -1 || bind(_listen, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == -1 ||
+      listen(_listen, SERVER_BACKLOG) == -1) {
+    std::cerr << "Unable to listen on " << path << std::endl;
+    if (_listen != -1) {
+      ::close(_listen);
+      _listen = -1;
+    }
+  }
+}
+
+// Disconnects every client and removes the socket
+RenderServer::~RenderServer() {
+  while (!_sessions.empty()) {
+    close(_sessions.size() - 1);
+  }
+  if (_listen != -1) {
+    ::close(_listen);
+    unlink(_path.c_str());
+  }
+}
+
+// Checks whether the server is listening
+bool RenderServer::isOpen() const {
+  return _listen != -1;
+}
+
+// Accepts every pending connection
+void RenderServer::accept() {
+  while (true) {
+    // Left blocking, as the presenter writes whole frames; requests are read without waiting instead
+    int fd = accept4(_listen, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return;  // None left
+    }
+    std::unique_ptr<Session> session(new Session);
+    session->fd = fd;
+    session->presenter.reset(new Presenter(fd));
+    _sessions.push_back(std::move(session));
+    std::cout << "Client connected, " << _sessions.size() << " in total" << std::endl;
+  }
+}
+
+// Reads what a client sent and applies its complete requests
+bool RenderServer::receive(Session &session) {
+  char buffer[256];
+  while (true) {
+    ssize_t got = recv(session.fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+    if (got == 0) {
+      return false;  // The client left
+    }
+    if (got < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    session.input.append(buffer, got);
+    while (session.input.size() >= sizeof(SessionRequest)) {
+      SessionRequest request;
+      std::memcpy(&request, session.input.data(), sizeof(request));
+      session.input.erase(0, sizeof(request));
+      if (!apply(session, request)) {
+        return false;
+      }
+    }
+  }
+}
+
+// Opens, resizes or restyles a session's view
+bool RenderServer::apply(Session &session, const SessionRequest &request) {
+  if (std::memcmp(request.magic, SERVER_MAGIC, sizeof(request.magic)) != 0 || request.rows == 0 ||
+      request.cols == 0 || request.rows > SERVER_MAX_SIDE || request.cols > SERVER_MAX_SIDE ||
+      request.glyphMode > static_cast<int>(GlyphMode::Braille) ||
+      request.colorMode > static_cast<int>(ColorMode::TrueColor)) {
+    std::cerr << "Invalid request from a client" << std::endl;
+    return false;
+  }
+  if (!session.camera) {
+    session.camera.reset(
+        new Camera(_model, Eigen::Vector3d(CAMERA_ORIGIN), Canvas(request.rows, request.cols), _pool));
+    session.camera->setRenderMode(_mode);
+    session.camera->setShadows(_shadows);
+    session.camera->setOutlines(_outlines);
+  } else {
+    session.camera->resize(request.rows, request.cols);
+  }
+  session.camera->setGlyphMode(static_cast<GlyphMode>(request.glyphMode));
+  session.camera->setColorMode(static_cast<ColorMode>(request.colorMode));
+  return true;
+}
+
+// Disconnects a client
+void RenderServer::close(size_t index) {
+  Session &session = *_sessions[index];
+  shutdown(session.fd, SHUT_RDWR);  // A presenter blocked on a client that stopped reading gives up
+  session.presenter.reset();
+  ::close(session.fd);
+  _sessions.erase(_sessions.begin() + index);
+  std::cout << "Client disconnected, " << _sessions.size() << " left" << std::endl;
+}
+
+// Renders and presents one frame for every open view
+void RenderServer::renderRound() {
+  _round.clear();
+  _firstTile.clear();
+  unsigned int tiles = 0;
+  for (auto &session : _sessions) {
+    if (!session->camera) {
+      continue;  // Still waiting for its first request
+    }
+    // Turning the camera against the model's rotation leaves the shared model untouched
+    session->camera->setOrigin(Eigen::AngleAxisd(-SERVER_STEP * session->frame, Eigen::Vector3d::UnitZ()) *
+                               Eigen::Vector3d(CAMERA_ORIGIN));
+    _round.push_back(session.get());
+    _firstTile.push_back(tiles);
+    tiles += session->camera->beginFrame();
+  }
+  _firstTile.push_back(tiles);
+
+  // The tiles of every view form one job, so any number of views keep every core busy
+  _pool.parallelFor(tiles, [&](unsigned int task, unsigned int) {
+    size_t k = std::upper_bound(_firstTile.begin(), _firstTile.end(), task) - _firstTile.begin() - 1;
+    _round[k]->camera->renderTile(task - _firstTile[k]);
+  });
+  _pool.parallelFor(static_cast<unsigned int>(_round.size()), [&](unsigned int k, unsigned int) {
+    _round[k]->camera->finishFrame();
+    _round[k]->presenter->submit(_round[k]->camera->canvas());
+    _round[k]->frame++;
+  });
+}
+
+// Selects how primary visibility is computed for every view opened afterwards
+void RenderServer::setRenderMode(RenderMode mode) {
+  _mode = mode;
+}
+
+// Turns hard shadows on or off for every view opened afterwards
+void RenderServer::setShadows(bool enabled) {
+  _shadows = enabled;
+}
+
+// Turns outlines on or off for every view opened afterwards
+void RenderServer::setOutlines(bool enabled) {
+  _outlines = enabled;
+}
+
+// Serves clients until told to stop
+void RenderServer::run(double fps, const volatile std::sig_atomic_t &stop) {
+  std::signal(SIGPIPE, SIG_IGN);  // A client leaving shows up as a failed write rather than killing the server
+  std::cout << "Serving on " << _path << std::endl;
+  const auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(1 / fps));
+  auto next = std::chrono::steady_clock::now();
+  std::vector<pollfd> fds;
+  while (!stop) {
+    fds.clear();
+    fds.push_back({_listen, POLLIN, 0});
+    for (auto &session : _sessions) {
+      fds.push_back({session->fd, POLLIN, 0});
+    }
+    int timeout = -1;  // Nothing to render until a client connects
+    if (!_sessions.empty()) {
+      auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(next - std::chrono::steady_clock::now());
+      timeout = static_cast<int>(std::max<long long>(0, wait.count()));
+    }
+    if (poll(fds.data(), fds.size(), timeout) == -1 && errno != EINTR) {
+      std::cerr << "Failed to wait for clients." << std::endl;
+      return;
+    }
+
+    // Backwards, so closing a session does not move the ones still to look at
+    for (size_t i = _sessions.size(); i-- > 0;) {
+      bool open = !_sessions[i]->presenter->failed();
+      if (open && (fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR))) {
+        open = receive(*_sessions[i]);
+      }
+      if (!open) {
+        close(i);
+      }
+    }
+    if (fds[0].revents & POLLIN) {
+      accept();
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (now >= next) {
+      renderRound();
+      next = std::max(next + interval, now);  // A late round does not make the next ones hurry
+    }
+  }
+}
+
+// Shows the view served by a RenderServer on this terminal
+int runClient(const std::string &path, GlyphMode glyphs, ColorMode colors, const volatile std::sig_atomic_t &stop) {
+  sockaddr_un address;
+  if (!socketAddress(path, address)) {
+    return EXIT_FAILURE;
+  }
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd == -1 || connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == -1) {
+    std::cerr << "Unable to reach the server at " << path << std::endl;
+    if (fd != -1) {
+      ::close(fd);
+    }
+    return EXIT_FAILURE;
+  }
+
+  // Tells the server the size of the terminal
+  auto sendSize = [&]() {
+    int rows, cols;
+    if (!Camera::terminalSize(rows, cols)) {
+      std::cerr << "Failed to get terminal size." << std::endl;
+      return false;
+    }
+    SessionRequest request = {};
+    std::memcpy(request.magic, SERVER_MAGIC, sizeof(request.magic));
+    request.rows = static_cast<uint16_t>(std::min(std::max(rows, 1), SERVER_MAX_SIDE));
+    request.cols = static_cast<uint16_t>(std::min(std::max(cols, 1), SERVER_MAX_SIDE));
+    request.glyphMode = static_cast<uint8_t>(glyphs);
+    request.colorMode = static_cast<uint8_t>(colors);
+    return send(fd, &request, sizeof(request), MSG_NOSIGNAL) == static_cast<ssize_t>(sizeof(request));
+  };
+
+  Camera::watchResize();
+  if (!sendSize()) {
+    ::close(fd);
+    return EXIT_FAILURE;
+  }
+  std::cout.flush();
+  bool ok = true;
+  char buffer[1 << 16];
+  while (ok && !stop) {
+    if (Camera::resizePending() && !sendSize()) {
+      ok = false;
+      break;
+    }
+    // poll() is never restarted, so a resize or Ctrl-C is seen right away
+    pollfd readable = {fd, POLLIN, 0};
+    if (poll(&readable, 1, -1) == -1) {
+      ok = errno == EINTR;
+      if (!ok) {
+        std::cerr << "Failed to wait for the server." << std::endl;
+      }
+      continue;
+    }
+    ssize_t got = read(fd, buffer, sizeof(buffer));
+    if (got <= 0) {
+      ok = got < 0 && errno == EINTR;
+      if (!ok) {
+        std::cerr << (got == 0 ? "The server closed the connection." : "Failed to read from the server.") << std::endl;
+      }
+      continue;
+    }
+    for (ssize_t done = 0; done < got;) {
+      ssize_t written = write(STDOUT_FILENO, buffer + done, got - done);
+      if (written < 0 && errno != EINTR) {
+        std::cerr << "Failed to write the frame." << std::endl;
+        ok = false;
+        break;
+      }
+      done += std::max<ssize_t>(0, written);
+    }
+  }
+  ::close(fd);
+  std::cout << std::endl;
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;  // Only being told to stop is a clean exit
+}
@@ -0,0 +1,160 @@
+#ifndef _RENDER_SERVER_H_
+#define _RENDER_SERVER_H_
+
+#include <csignal>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Camera.h"
+#include "Presenter.h"
+
+#define SERVER_MAGIC "CAVE"     // First bytes of every request, with the protocol version in the last one
+#define SERVER_BACKLOG 16       // Connections waiting to be accepted
+#define SERVER_MAX_SIDE 1024    // Most rows or columns a session may ask for
+#define SERVER_STEP (M_PI / 20) // Rotation of every view from one frame to the next, as in the interactive loop
+
+/**
+ * @brief Request a client sends when it connects and whenever its terminal changes.
+ * The first request opens the session's view; later ones resize it or
+ * change how it is drawn. Numbers are in host byte order, as both ends
+ * share the machine.
+ */
+struct SessionRequest {
+  char magic[4];     ///< SERVER_MAGIC, without its terminator
+  uint16_t rows;     ///< Rows of the client's terminal
+  uint16_t cols;     ///< Columns of the client's terminal
+  uint8_t glyphMode; ///< GlyphMode to draw with
+  uint8_t colorMode; ///< ColorMode to draw with
+  uint8_t pad[2];    ///< Zero
+};
+
+/**
+ * @brief Serves views of one loaded model to any number of terminals over a Unix domain socket.
+ * Every client gets a session of its own: a camera orbiting the model,
+ * so the model itself is never changed and is shared by all of them,
+ * and a presenter writing the frames to the client's socket. The server
+ * renders in rounds, each giving every session exactly one frame. The
+ * tiles of all the round's frames go through a single parallelFor() of
+ * the shared pool, so the cores are kept busy whether one large view or
+ * many small ones are open, and no session waits for another's next
+ * frame. A client that cannot keep up only drops its own frames.
+ */
+class RenderServer {
+ private:
+  /**
+   * @brief One connected client.
+   */
+  struct Session {
+    int fd;                               ///< The client's socket
+    std::string input;                    ///< Bytes of a request not fully received yet
+    std::unique_ptr<Camera> camera;       ///< The client's view, nullptr until its first request
+    std::unique_ptr<Presenter> presenter; ///< Writes the frames to the socket
+    unsigned long frame = 0;              ///< Frames rendered for the client
+  };
+
+  const Model &_model;                            ///< The model every session views, only read
+  std::string _path;                              ///< Path of the listening socket
+  int _listen = -1;                               ///< The listening socket, -1 if it could not be opened
+  std::vector<std::unique_ptr<Session>> _sessions; ///< Connected clients
+  std::vector<Session *> _round;                  ///< Sessions rendered in the current round
+  std::vector<unsigned int> _firstTile;           ///< First task of each session's tiles in the round, and the total
+  ThreadPool &_pool;                              ///< Threads tracing the tiles of every session
+  RenderMode _mode = RenderMode::Packet;          ///< How every view computes primary visibility
+  bool _shadows = false;                          ///< Whether every view casts hard shadows
+  bool _outlines = false;                         ///< Whether every view outlines silhouettes and creases
+
+  /**
+   * @brief Accepts every pending connection.
+   */
+  void accept();
+
+  /**
+   * @brief Reads what a client sent and applies its complete requests.
+   * @param session The client.
+   * @return False if the client left or sent something invalid.
+   */
+  bool receive(Session &session);
+
+  /**
+   * @brief Opens, resizes or restyles a session's view.
+   * @param session The client.
+   * @param request The request it sent.
+   * @return False if the request is invalid.
+   */
+  bool apply(Session &session, const SessionRequest &request);
+
+  /**
+   * @brief Disconnects a client.
+   * @param index The index of its session.
+   */
+  void close(size_t index);
+
+  /**
+   * @brief Renders and presents one frame for every open view.
+   */
+  void renderRound();
+
+ public:
+  /**
+   * @brief Starts listening for clients.
+   * A stale socket left at the path by an earlier server is replaced.
+   * @param model The model to serve, which must outlive the server.
+   * @param path The path of the socket.
+   */
+  RenderServer(const Model &model, const std::string &path);
+
+  /**
+   * @brief Disconnects every client and removes the socket.
+   */
+  ~RenderServer();
+
+  RenderServer(const RenderServer &) = delete;
+  RenderServer &operator=(const RenderServer &) = delete;
+
+  /**
+   * @brief Checks whether the server is listening.
+   * @return True if clients can connect.
+   */
+  bool isOpen() const;
+
+  /**
+   * @brief Selects how primary visibility is computed for every view opened afterwards.
+   * @param mode The render mode.
+   */
+  void setRenderMode(RenderMode mode);
+
+  /**
+   * @brief Turns hard shadows on or off for every view opened afterwards.
+   * @param enabled True to cast shadows.
+   */
+  void setShadows(bool enabled);
+
+  /**
+   * @brief Turns outlines on or off for every view opened afterwards.
+   * @param enabled True to outline silhouettes and creases.
+   */
+  void setOutlines(bool enabled);
+
+  /**
+   * @brief Serves clients until told to stop.
+   * @param fps The most rounds per second.
+   * @param stop Set, usually by a signal handler, to make the server return.
+   */
+  void run(double fps, const volatile std::sig_atomic_t &stop);
+};
+
+/**
+ * @brief Shows the view served by a RenderServer on this terminal.
+ * Sends the terminal's size, and its new size whenever it changes, then
+ * copies what the server sends to standard output.
+ * @param path The path of the server's socket.
+ * @param glyphs How the server should draw the cells.
+ * @param colors Whether and how the server should colour them.
+ * @param stop Set, usually by a signal handler, to disconnect.
+ * @return EXIT_SUCCESS once told to stop, or EXIT_FAILURE if the server could not be
+ * reached, closed the connection, or the frames could not be shown.
+ */
+int runClient(const std::string &path, GlyphMode glyphs, ColorMode colors, const volatile std::sig_atomic_t &stop);
+
+#endif //_RENDER_SERVER_H_
@@ -0,0 +1,36 @@
+#include <algorithm>
+#include "ShadingBuffer.h"
+
+// Changes the number of samples and marks all of them as misses
+void ShadingBuffer::resize(int rows, int cols) {
+  _rows = std::max(0, rows);
+  _cols = std::max(0, cols);
+  _stride = cacheStride<float>(_cols);
+  size_t size = static_cast<size_t>(_rows) * _stride;
+  _brightness.assign(size, -INFINITY);
+  _depth.assign(size, INFINITY);
+  _faces.assign(size, SHADING_NO_FACE);
+  for (auto &normal : _normals) {
+    normal.assign(size, 0);
+  }
+}
+
+// Spreads every sample of the top-left grid over the block it stands for
+void ShadingBuffer::upscale(int scale) {
+  if (scale == 1) {
+    return;
+  }
+  // A block's traced sample is never after the block, so walking backwards reads it before it is overwritten
+  for (int i = _rows - 1; i >= 0; i--) {
+    size_t traced = static_cast<size_t>(i / scale) * _stride;
+    size_t row = static_cast<size_t>(i) * _stride;
+    for (int j = _cols - 1; j >= 0; j--) {
+      _brightness[row + j] = _brightness[traced + j / scale];
+      _depth[row + j] = _depth[traced + j / scale];
+      _faces[row + j] = _faces[traced + j / scale];
+      for (auto &normal : _normals) {
+        normal[row + j] = normal[traced + j / scale];
+      }
+    }
+  }
+}
@@ -0,0 +1,129 @@
+#ifndef _SHADING_BUFFER_H_
+#define _SHADING_BUFFER_H_
+
+#include <cmath>
+#include <cstdint>
+#include <Eigen/Dense>
+#include "CacheAligned.h"
+
+#define SHADING_NO_FACE 0xFFFFFFFFu  // Face id of a sample whose ray hit nothing
+
+/**
+ * @brief What the rays of a frame found, one sample per ray, as a structure of arrays.
+ * Brightness, depth, face id and normal sit in separate arrays sharing one row
+ * stride, padded to whole cache lines so tiles traced by different threads
+ * never write the same line. Drawing only streams through the brightness;
+ * the depth, face id and normal are there for passes that look at the geometry.
+ * The padding past the last column stays a miss, so whole vectors can be
+ * read from the start of any row. Resizing keeps the capacity, so the
+ * frame loop never allocates once the largest size has been seen.
+ */
+class ShadingBuffer {
+ private:
+  int _rows = 0;                         ///< Rows of samples
+  int _cols = 0;                         ///< Columns of samples
+  int _stride = 0;                       ///< Distance between two rows in every array
+  CacheAlignedVector<float> _brightness; ///< Brightness of every sample, -INFINITY where nothing was hit
+  CacheAlignedVector<float> _depth;      ///< Distance along the view axis to the hit, INFINITY where nothing was hit
+  CacheAlignedVector<uint32_t> _faces;   ///< Face hit by every sample, SHADING_NO_FACE where nothing was hit
+  CacheAlignedVector<float> _normals[3]; ///< World-space normal of every sample, one array per axis, 0 where nothing was hit
+
+ public:
+  /**
+   * @brief Changes the number of samples and marks all of them as misses.
+   * @param rows The number of rows of samples.
+   * @param cols The number of columns of samples.
+   */
+  void resize(int rows, int cols);
+
+  /**
+   * @brief Spreads every sample of the top-left grid over the scale x scale block it stands for.
+   * Works in place from the last sample back, so no block overwrites a
+   * sample that is still needed.
+   * @param scale The samples along each axis sharing one traced sample.
+   */
+  void upscale(int scale);
+
+  /**
+   * @brief Returns the number of rows of samples.
+   * @return The row count.
+   */
+  int rows() const { return _rows; }
+
+  /**
+   * @brief Returns the number of columns of samples.
+   * @return The column count.
+   */
+  int cols() const { return _cols; }
+
+  /**
+   * @brief Returns the distance between two rows in every array.
+   * @return The stride, in elements.
+   */
+  int stride() const { return _stride; }
+
+  /**
+   * @brief Retrieves the brightness of every sample.
+   * @return The first sample of the first row.
+   */
+  const float *brightness() const { return _brightness.data(); }
+
+  /**
+   * @brief Retrieves the depth of every sample.
+   * @return The first sample of the first row.
+   */
+  const float *depth() const { return _depth.data(); }
+
+  /**
+   * @brief Retrieves the face id of every sample.
+   * @return The first sample of the first row.
+   */
+  const uint32_t *faces() const { return _faces.data(); }
+
+  /**
+   * @brief Retrieves one coordinate of the normal of every sample.
+   * @param axis 0, 1 or 2 for the world x, y or z coordinate.
+   * @return The first sample of the first row.
+   */
+  const float *normals(int axis) const { return _normals[axis].data(); }
+
+  /**
+   * @brief Records what a sample's ray hit.
+   * @param i The sample row.
+   * @param j The sample column.
+   * @param brightness The brightness of the surface.
+   * @param depth The distance along the view axis to the hit.
+   * @param face The face hit.
+   * @param normal The normal of the surface, in world space.
+   */
+  void set(int i, int j, float brightness, float depth, uint32_t face, const Eigen::Vector3d &normal) {
+    size_t k = static_cast<size_t>(i) * _stride + j;
+    _brightness[k] = brightness;
+    _depth[k] = depth;
+    _faces[k] = face;
+    for (int a = 0; a < 3; a++) {
+      _normals[a][k] = static_cast<float>(normal[a]);
+    }
+  }
+
+  /**
+   * @brief Takes some light away from a sample that hit.
+   * @param i The sample row.
+   * @param j The sample column.
+   * @param amount The brightness to remove.
+   */
+  void darken(int i, int j, float amount) {
+    _brightness[static_cast<size_t>(i) * _stride + j] -= amount;
+  }
+
+  /**
+   * @brief Records that a sample's ray hit nothing.
+   * @param i The sample row.
+   * @param j The sample column.
+   */
+  void miss(int i, int j) {
+    set(i, j, -INFINITY, INFINITY, SHADING_NO_FACE, Eigen::Vector3d::Zero());
+  }
+};
+
+#endif //_SHADING_BUFFER_H_
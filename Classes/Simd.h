@@ -0,0 +1,129 @@
+#ifndef _SIMD_H_
+#define _SIMD_H_
+
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define SIMD_WIDTH 8  // Floats processed by one floatv operation
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SIMD_WIDTH 4
+#else
+#define SIMD_WIDTH 4
+#endif
+
+/**
+ * @brief Minimal float vector used by the intersection kernels.
+ * Maps to AVX or SSE registers where available and to a plain array
+ * otherwise, so every kernel is written once for all targets.
+ */
+struct floatv;
+
+/**
+ * @brief Per-lane boolean produced by comparing two floatv.
+ */
+struct maskv;
+
+#if defined(__AVX__)
+
+struct floatv { __m256 v; };
+struct maskv { __m256 v; };
+
+inline floatv broadcast(float x) { return {_mm256_set1_ps(x)}; }
+inline floatv load(const float *p) { return {_mm256_loadu_ps(p)}; }
+inline void store(float *p, floatv a) { _mm256_storeu_ps(p, a.v); }
+inline floatv operator+(floatv a, floatv b) { return {_mm256_add_ps(a.v, b.v)}; }
+inline floatv operator-(floatv a, floatv b) { return {_mm256_sub_ps(a.v, b.v)}; }
+inline floatv operator*(floatv a, floatv b) { return {_mm256_mul_ps(a.v, b.v)}; }
+inline floatv operator/(floatv a, floatv b) { return {_mm256_div_ps(a.v, b.v)}; }
+inline floatv min(floatv a, floatv b) { return {_mm256_min_ps(a.v, b.v)}; }
+inline floatv max(floatv a, floatv b) { return {_mm256_max_ps(a.v, b.v)}; }
+inline floatv abs(floatv a) { return {_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v)}; }
+inline maskv operator<(floatv a, floatv b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)}; }
+inline maskv operator<=(floatv a, floatv b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)}; }
+inline maskv operator>(floatv a, floatv b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)}; }
+inline maskv operator>=(floatv a, floatv b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ)}; }
+inline maskv operator==(floatv a, floatv b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ)}; }
+inline maskv operator&(maskv a, maskv b) { return {_mm256_and_ps(a.v, b.v)}; }
+inline maskv operator|(maskv a, maskv b) { return {_mm256_or_ps(a.v, b.v)}; }
+inline floatv select(maskv m, floatv a, floatv b) { return {_mm256_blendv_ps(b.v, a.v, m.v)}; }
+inline int bits(maskv m) { return _mm256_movemask_ps(m.v); }
+inline float hmin(floatv a) {
+  __m256 m = _mm256_min_ps(a.v, _mm256_permute2f128_ps(a.v, a.v, 1));
+  m = _mm256_min_ps(m, _mm256_permute_ps(m, _MM_SHUFFLE(1, 0, 3, 2)));
+  m = _mm256_min_ps(m, _mm256_permute_ps(m, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm256_cvtss_f32(m);
+}
+
+#elif defined(__SSE2__)
+
+struct floatv { __m128 v; };
+struct maskv { __m128 v; };
+
+inline floatv broadcast(float x) { return {_mm_set1_ps(x)}; }
+inline floatv load(const float *p) { return {_mm_loadu_ps(p)}; }
+inline void store(float *p, floatv a) { _mm_storeu_ps(p, a.v); }
+inline floatv operator+(floatv a, floatv b) { return {_mm_add_ps(a.v, b.v)}; }
+inline floatv operator-(floatv a, floatv b) { return {_mm_sub_ps(a.v, b.v)}; }
+inline floatv operator*(floatv a, floatv b) { return {_mm_mul_ps(a.v, b.v)}; }
+inline floatv operator/(floatv a, floatv b) { return {_mm_div_ps(a.v, b.v)}; }
+inline floatv min(floatv a, floatv b) { return {_mm_min_ps(a.v, b.v)}; }
+inline floatv max(floatv a, floatv b) { return {_mm_max_ps(a.v, b.v)}; }
+inline floatv abs(floatv a) { return {_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v)}; }
+inline maskv operator<(floatv a, floatv b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+inline maskv operator<=(floatv a, floatv b) { return {_mm_cmple_ps(a.v, b.v)}; }
+inline maskv operator>(floatv a, floatv b) { return {_mm_cmpgt_ps(a.v, b.v)}; }
+inline maskv operator>=(floatv a, floatv b) { return {_mm_cmpge_ps(a.v, b.v)}; }
+inline maskv operator==(floatv a, floatv b) { return {_mm_cmpeq_ps(a.v, b.v)}; }
+inline maskv operator&(maskv a, maskv b) { return {_mm_and_ps(a.v, b.v)}; }
+inline maskv operator|(maskv a, maskv b) { return {_mm_or_ps(a.v, b.v)}; }
+inline floatv select(maskv m, floatv a, floatv b) { return {_mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v))}; }
+inline int bits(maskv m) { return _mm_movemask_ps(m.v); }
+inline float hmin(floatv a) {
+  __m128 m = _mm_min_ps(a.v, _mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(1, 0, 3, 2)));
+  m = _mm_min_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtss_f32(m);
+}
+
+#else
+
+struct floatv { float v[SIMD_WIDTH]; };
+struct maskv { bool v[SIMD_WIDTH]; };
+
+#define SIMD_LANEWISE(type, expr) type r; for (int l = 0; l < SIMD_WIDTH; l++) r.v[l] = (expr); return r
+
+inline floatv broadcast(float x) { SIMD_LANEWISE(floatv, x); }
+inline floatv load(const float *p) { SIMD_LANEWISE(floatv, p[l]); }
+inline void store(float *p, floatv a) { for (int l = 0; l < SIMD_WIDTH; l++) p[l] = a.v[l]; }
+inline floatv operator+(floatv a, floatv b) { SIMD_LANEWISE(floatv, a.v[l] + b.v[l]); }
+inline floatv operator-(floatv a, floatv b) { SIMD_LANEWISE(floatv, a.v[l] - b.v[l]); }
+inline floatv operator*(floatv a, floatv b) { SIMD_LANEWISE(floatv, a.v[l] * b.v[l]); }
+inline floatv operator/(floatv a, floatv b) { SIMD_LANEWISE(floatv, a.v[l] / b.v[l]); }
+inline floatv min(floatv a, floatv b) { SIMD_LANEWISE(floatv, a.v[l] < b.v[l] ? a.v[l] : b.v[l]); }
+inline floatv max(floatv a, floatv b) { SIMD_LANEWISE(floatv, a.v[l] > b.v[l] ? a.v[l] : b.v[l]); }
+inline floatv abs(floatv a) { SIMD_LANEWISE(floatv, std::fabs(a.v[l])); }
+inline maskv operator<(floatv a, floatv b) { SIMD_LANEWISE(maskv, a.v[l] < b.v[l]); }
+inline maskv operator<=(floatv a, floatv b) { SIMD_LANEWISE(maskv, a.v[l] <= b.v[l]); }
+inline maskv operator>(floatv a, floatv b) { SIMD_LANEWISE(maskv, a.v[l] > b.v[l]); }
+inline maskv operator>=(floatv a, floatv b) { SIMD_LANEWISE(maskv, a.v[l] >= b.v[l]); }
+inline maskv operator==(floatv a, floatv b) { SIMD_LANEWISE(maskv, a.v[l] == b.v[l]); }
+inline maskv operator&(maskv a, maskv b) { SIMD_LANEWISE(maskv, a.v[l] && b.v[l]); }
+inline maskv operator|(maskv a, maskv b) { SIMD_LANEWISE(maskv, a.v[l] || b.v[l]); }
+inline floatv select(maskv m, floatv a, floatv b) { SIMD_LANEWISE(floatv, m.v[l] ? a.v[l] : b.v[l]); }
+inline int bits(maskv m) {
+  int r = 0;
+  for (int l = 0; l < SIMD_WIDTH; l++) r |= m.v[l] << l;
+  return r;
+}
+inline float hmin(floatv a) {
+  float m = a.v[0];
+  for (int l = 1; l < SIMD_WIDTH; l++) m = a.v[l] < m ? a.v[l] : m;
+  return m;
+}
+
+#undef SIMD_LANEWISE
+
+#endif
+
+#endif //_SIMD_H_
@@ -0,0 +1,127 @@
+#include "ThreadPool.h"
+
+// Starts the pool
+ThreadPool::ThreadPool(unsigned int threads) {
+  if (threads == 0) {
+    threads = 1;  // hardware_concurrency() may not know
+  }
+  for (unsigned int i = 0; i < threads; i++) {
+    _queues.emplace_back(new Queue());
+  }
+  // The last queue belongs to whichever thread calls parallelFor()
+  for (unsigned int i = 0; i + 1 < threads; i++) {
+    _workers.emplace_back(&ThreadPool::workerLoop, this, i);
+  }
+}
+
+// Stops and joins the worker threads
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stop = true;
+  }
+  _wake.notify_all();
+  for (std::thread &worker : _workers) {
+    worker.join();
+  }
+}
+
+// Retrieves the process-wide pool, sized to the available cores
+ThreadPool &ThreadPool::shared() {
+  static ThreadPool pool;
+  return pool;
+}
+
+// Retrieves the number of threads taking part in each job
+unsigned int ThreadPool::size() const {
+  return static_cast<unsigned int>(_queues.size());
+}
+
+// Runs fn(task, thread) for every task in [0, count) and waits for all of them
+void ThreadPool::run(unsigned int count, const std::function<void(unsigned int, unsigned int)> &fn) {
+  if (count == 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> caller(_callerMutex);
+
+  // Publish the job before any task becomes visible to a thread already looking for work
+  unsigned int threads = size();
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _job = &fn;
+    _pending = count;
+    _generation++;
+
+    // Deal contiguous runs of tasks to every thread
+    for (unsigned int q = 0; q < threads; q++) {
+      std::lock_guard<std::mutex> queueLock(_queues[q]->mutex);
+      _queues[q]->begin = static_cast<unsigned int>(static_cast<unsigned long long>(count) * q / threads);
+      _queues[q]->end = static_cast<unsigned int>(static_cast<unsigned long long>(count) * (q + 1) / threads);
+    }
+  }
+  _wake.notify_all();
+
+  work(threads - 1);
+
+  std::unique_lock<std::mutex> lock(_mutex);
+  _done.wait(lock, [this] { return _pending == 0 && _active == 0; });
+  _job = nullptr;
+}
+
+// Main loop of a worker thread
+void ThreadPool::workerLoop(unsigned int index) {
+  unsigned long seen = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _wake.wait(lock, [&] { return _stop || _generation != seen; });
+      if (_stop) {
+        return;
+      }
+      seen = _generation;
+      _active++;
+    }
+
+    work(index);
+
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _active--;
+    }
+    _done.notify_all();
+  }
+}
+
+// Runs tasks of the current job until no queue has any left
+void ThreadPool::work(unsigned int index) {
+  unsigned int task;
+  while (take(index, task)) {
+    (*_job)(task, index);
+    if (--_pending == 0) {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _done.notify_all();
+    }
+  }
+}
+
+// Takes the next task, first from the thread's own queue, then from the others
+bool ThreadPool::take(unsigned int index, unsigned int &task) {
+  {
+    Queue &own = *_queues[index];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (own.begin < own.end) {
+      task = own.begin++;  // Own work in order, so neighbouring tiles run back to back
+      return true;
+    }
+  }
+
+  for (unsigned int i = 1; i < _queues.size(); i++) {
+    Queue &victim = *_queues[(index + i) % _queues.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (victim.begin < victim.end) {
+      task = --victim.end;  // Steal from the far end, away from the owner
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,113 @@
+#ifndef _THREAD_POOL_H_
+#define _THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Persistent pool of worker threads with work-stealing task queues.
+ * Every participating thread owns a contiguous run of task indices. Threads
+ * take work from the front of their own run and, once it is empty, steal
+ * from the back of the others, so uneven tiles balance out without a
+ * central queue. The thread calling parallelFor() takes part in the work
+ * as well. Running a job allocates nothing.
+ */
+class ThreadPool {
+ private:
+  /**
+   * @brief Tasks left to one participating thread, the indices in [begin, end).
+   */
+  struct Queue {
+    std::mutex mutex;
+    unsigned int begin = 0;
+    unsigned int end = 0;
+  };
+
+  std::vector<std::thread> _workers;              ///< Worker threads, the caller excluded
+  std::vector<std::unique_ptr<Queue>> _queues;    ///< One run of tasks per participating thread
+  const std::function<void(unsigned int, unsigned int)> *_job = nullptr;  ///< Job being run
+  std::atomic<unsigned int> _pending{0};          ///< Tasks of the current job not yet finished
+  unsigned int _active = 0;                       ///< Workers currently inside work()
+  unsigned long _generation = 0;                  ///< Incremented for every job
+  bool _stop = false;                             ///< Set when the pool shuts down
+  std::mutex _mutex;                              ///< Guards the job hand-off
+  std::condition_variable _wake;                  ///< Signals workers that a job arrived
+  std::condition_variable _done;                  ///< Signals the caller that the job finished
+  std::mutex _callerMutex;                        ///< Serializes concurrent parallelFor() calls
+
+  /**
+   * @brief Main loop of a worker thread.
+   * @param index The index of the worker's queue.
+   */
+  void workerLoop(unsigned int index);
+
+  /**
+   * @brief Runs tasks of the current job until no queue has any left.
+   * @param index The index of the calling thread's queue.
+   */
+  void work(unsigned int index);
+
+  /**
+   * @brief Takes the next task, first from the thread's own queue, then from the others.
+   * @param index The index of the calling thread's queue.
+   * @param task Receives the task.
+   * @return True if a task was found.
+   */
+  bool take(unsigned int index, unsigned int &task);
+
+  /**
+   * @brief Runs fn(task, thread) for every task in [0, count) and waits for all of them.
+   * @param count The number of tasks.
+   * @param fn The function to run for each task.
+   */
+  void run(unsigned int count, const std::function<void(unsigned int, unsigned int)> &fn);
+
+ public:
+  /**
+   * @brief Starts the pool.
+   * @param threads The number of threads taking part in each job, the caller included.
+   */
+  explicit ThreadPool(unsigned int threads = std::thread::hardware_concurrency());
+
+  /**
+   * @brief Stops and joins the worker threads.
+   */
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  /**
+   * @brief Retrieves the process-wide pool, sized to the available cores.
+   * @return The shared pool.
+   */
+  static ThreadPool &shared();
+
+  /**
+   * @brief Retrieves the number of threads taking part in each job.
+   * @return The thread count, the caller included.
+   */
+  unsigned int size() const;
+
+  /**
+   * @brief Runs fn(task, thread) for every task in [0, count) and waits for all of them.
+   * Consecutive tasks are dealt to the same thread so neighbouring tiles stay
+   * together unless they get stolen. `thread` is in [0, size()) and unique
+   * among the threads running concurrently.
+   * The function is only referenced by the job, never copied, so however
+   * much a lambda captures, no job allocates.
+   * @param count The number of tasks.
+   * @param fn The function to run for each task.
+   */
+  template <typename Fn>
+  void parallelFor(unsigned int count, const Fn &fn) {
+    run(count, std::cref(fn));  // A reference wrapper always fits in std::function's own storage
+  }
+};
+
+#endif //_THREAD_POOL_H_
@@ -0,0 +1,22 @@
+#include "TriangleBlock.h"
+
+// Packs the triangles of a mesh, in their current order, into blocks
+std::vector<TriangleBlock> packTriangles(const Mesh &mesh) {
+  unsigned int count = mesh.triangleCount();
+  std::vector<TriangleBlock> blocks((count + TRI_LANES - 1) / TRI_LANES, TriangleBlock());
+
+  for (unsigned int i = 0; i < count; i++) {
+    TriangleBlock &block = blocks[i / TRI_LANES];
+    unsigned int lane = i % TRI_LANES;
+    const triangle &tri = mesh.getTriangle(i);
+    const Eigen::Vector3d &a = mesh.position(tri[0]);
+    Eigen::Vector3d e1 = mesh.position(tri[1]) - a;
+    Eigen::Vector3d e2 = mesh.position(tri[2]) - a;
+    for (int axis = 0; axis < 3; axis++) {
+      block.v0[axis][lane] = static_cast<float>(a[axis]);
+      block.e1[axis][lane] = static_cast<float>(e1[axis]);
+      block.e2[axis][lane] = static_cast<float>(e2[axis]);
+    }
+  }
+  return blocks;
+}
@@ -0,0 +1,166 @@
+#ifndef _TRIANGLE_BLOCK_H_
+#define _TRIANGLE_BLOCK_H_
+
+#include <cmath>
+#include <vector>
+#include <Eigen/Dense>
+#include "Mesh.h"
+#include "Face.h"
+#include "Simd.h"
+
+#define TRI_LANES SIMD_WIDTH  // Triangles tested together by one intersectBlock call
+
+#define BLOCK_EPSILON 1e-12f  // Determinant below which a lane counts as parallel to the ray
+
+/**
+ * @brief Structure-of-arrays packing of TRI_LANES triangles.
+ * Every triangle is stored as its first vertex and the two edges leaving it,
+ * which is all Möller–Trumbore needs. Unused lanes have zero edges, so their
+ * determinant is zero and they never report a hit.
+ */
+struct TriangleBlock {
+  float v0[3][TRI_LANES];  ///< First vertex, per axis then per lane
+  float e1[3][TRI_LANES];  ///< Edge from the first to the second vertex
+  float e2[3][TRI_LANES];  ///< Edge from the first to the third vertex
+};
+
+/**
+ * @brief A ray prepared for intersectBlock, broadcast across the lanes once.
+ */
+struct BlockRay {
+  floatv o[3];  ///< Origin, broadcast
+  floatv d[3];  ///< Direction, broadcast
+
+  /**
+   * @brief Broadcasts a ray.
+   * @param orig The origin point of the ray.
+   * @param dir The direction of the ray.
+   */
+  BlockRay(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir);
+};
+
+/**
+ * @brief Packs the triangles of a mesh, in their current order, into blocks.
+ * Triangle i ends up in lane i % TRI_LANES of block i / TRI_LANES.
+ * @param mesh The mesh to pack.
+ * @return The blocks, the last one padded with empty lanes.
+ */
+std::vector<TriangleBlock> packTriangles(const Mesh &mesh);
+
+/**
+ * @brief Tests one ray against every triangle of a block at once.
+ * All lanes are evaluated without branching; the hit mask is reduced to the
+ * closest lane at the end.
+ * @param ray The prepared ray.
+ * @param block The triangles to test.
+ * @param tMax The far end of the ray interval, shrunk to the hit on success.
+ * @param lane Receives the lane of the closest hit.
+ * @param u Receives the barycentric coordinate of the hit along e1.
+ * @param v Receives the barycentric coordinate of the hit along e2.
+ * @return True if some lane was hit closer than tMax.
+ */
+inline bool intersectBlock(const BlockRay &ray, const TriangleBlock &block,
+                           float &tMax, unsigned int &lane, float &u, float &v);
+
+/**
+ * @brief Tests SIMD_WIDTH rays sharing an origin against one triangle at once.
+ * This is the transposed kernel used by packet tracing: the triangle is
+ * broadcast and every lane holds a different ray.
+ * @param o The shared origin, broadcast.
+ * @param d The directions of the rays, per axis.
+ * @param block The block holding the triangle.
+ * @param slot The lane of the triangle within the block.
+ * @param t The far end of every ray's interval, shrunk where the triangle is hit.
+ * @param u Updated with the barycentric along e1 where the triangle is hit.
+ * @param v Updated with the barycentric along e2 where the triangle is hit.
+ * @return The lanes whose closest hit became this triangle.
+ */
+inline maskv intersectTriangle(const floatv o[3], const floatv d[3], const TriangleBlock &block, unsigned int slot,
+                               floatv &t, floatv &u, floatv &v);
+
+inline BlockRay::BlockRay(const Eigen::Vector3d &orig, const Eigen::Vector3d &dir) {
+  for (int a = 0; a < 3; a++) {
+    o[a] = broadcast(static_cast<float>(orig[a]));
+    d[a] = broadcast(static_cast<float>(dir[a]));
+  }
+}
+
+inline bool intersectBlock(const BlockRay &ray, const TriangleBlock &block,
+                           float &tMax, unsigned int &lane, float &u, float &v) {
+  const floatv e1x = load(block.e1[0]), e1y = load(block.e1[1]), e1z = load(block.e1[2]);
+  const floatv e2x = load(block.e2[0]), e2y = load(block.e2[1]), e2z = load(block.e2[2]);
+
+  // pvec = dir x e2, det = e1 . pvec
+  floatv px = ray.d[1] * e2z - ray.d[2] * e2y;
+  floatv py = ray.d[2] * e2x - ray.d[0] * e2z;
+  floatv pz = ray.d[0] * e2y - ray.d[1] * e2x;
+  floatv det = e1x * px + e1y * py + e1z * pz;
+  floatv invDet = broadcast(1.0f) / det;
+
+  // tvec = orig - v0, u = tvec . pvec / det
+  floatv tx = ray.o[0] - load(block.v0[0]);
+  floatv ty = ray.o[1] - load(block.v0[1]);
+  floatv tz = ray.o[2] - load(block.v0[2]);
+  floatv lu = (tx * px + ty * py + tz * pz) * invDet;
+
+  // qvec = tvec x e1, v = dir . qvec / det, t = e2 . qvec / det
+  floatv qx = ty * e1z - tz * e1y;
+  floatv qy = tz * e1x - tx * e1z;
+  floatv qz = tx * e1y - ty * e1x;
+  floatv lv = (ray.d[0] * qx + ray.d[1] * qy + ray.d[2] * qz) * invDet;
+  floatv lt = (e2x * qx + e2y * qy + e2z * qz) * invDet;
+
+  const floatv zero = broadcast(0.0f);
+  maskv mask = (abs(det) > broadcast(BLOCK_EPSILON)) & (lu >= zero) & (lv >= zero) & (lu + lv <= broadcast(1.0f))
+               & (lt > broadcast(static_cast<float>(EPSILON))) & (lt < broadcast(tMax));
+  if (bits(mask) == 0) {
+    return false;
+  }
+
+  // Min-t reduction over the hit lanes
+  floatv tHit = select(mask, lt, broadcast(INFINITY));
+  float tMin = hmin(tHit);
+  lane = static_cast<unsigned int>(__builtin_ctz(bits(tHit == broadcast(tMin))));
+
+  float lanes[TRI_LANES];
+  tMax = tMin;
+  store(lanes, lu);
+  u = lanes[lane];
+  store(lanes, lv);
+  v = lanes[lane];
+  return true;
+}
+
+inline maskv intersectTriangle(const floatv o[3], const floatv d[3], const TriangleBlock &block, unsigned int slot,
+                               floatv &t, floatv &u, floatv &v) {
+  const floatv e1x = broadcast(block.e1[0][slot]), e1y = broadcast(block.e1[1][slot]), e1z = broadcast(block.e1[2][slot]);
+  const floatv e2x = broadcast(block.e2[0][slot]), e2y = broadcast(block.e2[1][slot]), e2z = broadcast(block.e2[2][slot]);
+
+  // tvec and qvec only depend on the shared origin
+  floatv tx = o[0] - broadcast(block.v0[0][slot]);
+  floatv ty = o[1] - broadcast(block.v0[1][slot]);
+  floatv tz = o[2] - broadcast(block.v0[2][slot]);
+  floatv qx = ty * e1z - tz * e1y;
+  floatv qy = tz * e1x - tx * e1z;
+  floatv qz = tx * e1y - ty * e1x;
+
+  floatv px = d[1] * e2z - d[2] * e2y;
+  floatv py = d[2] * e2x - d[0] * e2z;
+  floatv pz = d[0] * e2y - d[1] * e2x;
+  floatv det = e1x * px + e1y * py + e1z * pz;
+  floatv invDet = broadcast(1.0f) / det;
+
+  floatv lu = (tx * px + ty * py + tz * pz) * invDet;
+  floatv lv = (d[0] * qx + d[1] * qy + d[2] * qz) * invDet;
+  floatv lt = (e2x * qx + e2y * qy + e2z * qz) * invDet;
+
+  const floatv zero = broadcast(0.0f);
+  maskv mask = (abs(det) > broadcast(BLOCK_EPSILON)) & (lu >= zero) & (lv >= zero) & (lu + lv <= broadcast(1.0f))
+               & (lt > broadcast(static_cast<float>(EPSILON))) & (lt < t);
+  t = select(mask, lt, t);
+  u = select(mask, lu, u);
+  v = select(mask, lv, v);
+  return mask;
+}
+
+#endif //_TRIANGLE_BLOCK_H_
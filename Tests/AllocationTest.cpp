@@ -0,0 +1,132 @@
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <thread>
+#include <unistd.h>
+#include "Camera.h"
+#include "Presenter.h"
+
+#define ALLOC_ROWS 12           // Rows of the canvas rendered, enough for several tiles in every glyph mode
+#define ALLOC_COLS 40           // Columns of the canvas rendered
+#define ALLOC_STEP (M_PI / 20)  // Rotation of the camera from one frame to the next, as in the interactive loop
+#define ALLOC_WARMUP 40         // Frames of one whole turn, which may allocate while buffers reach their sizes
+#define ALLOC_FRAMES 200        // Frames that must not allocate afterwards
+
+// Heap allocations made by any thread since the counter was last reset
+static std::atomic<unsigned long> allocations(0);
+
+void *operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(size > 0 ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) {
+  return operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return std::malloc(size > 0 ? size : 1);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  return operator new(size, std::nothrow);
+}
+
+void operator delete(void *p) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void *p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept {
+  std::free(p);
+}
+
+// Renders and presents frames in one combination of modes, returning the allocations once warmed up.
+// Buffers sized by what is in view, such as the rasterizer's tile bins, keep the largest size they
+// needed, so the warm-up turns the camera once around and the counted frames show views seen before.
+static unsigned long countAllocations(const Model &model, int fd, GlyphMode glyphs, ColorMode colors,
+                                      RenderMode mode, bool extras) {
+  Camera camera(model, Eigen::Vector3d(CAMERA_ORIGIN), Canvas(ALLOC_ROWS, ALLOC_COLS), ThreadPool::shared());
+  camera.setRenderMode(mode);
+  camera.setGlyphMode(glyphs);
+  camera.setColorMode(colors);
+  camera.setShadows(extras);
+  camera.setOutlines(extras);
+  std::unique_ptr<Presenter> presenter(new Presenter(fd));
+  for (int frame = 0; frame < ALLOC_WARMUP + ALLOC_FRAMES; frame++) {
+    if (frame == ALLOC_WARMUP) {
+      allocations = 0;
+    }
+    camera.setOrigin(Eigen::AngleAxisd(-ALLOC_STEP * frame, Eigen::Vector3d::UnitZ()) *
+                     Eigen::Vector3d(CAMERA_ORIGIN));
+    camera.rayTrace();
+    presenter->submit(camera.canvas());
+    // Every warm-up frame is presented, so each slot and the encoder see the layout before counting starts
+    while (frame < ALLOC_WARMUP && presenter->presented() <= static_cast<unsigned long>(frame)) {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  }
+  presenter.reset();  // Counts the frames the presenter thread was still encoding
+  return allocations;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: " << argv[0] << " MODEL.obj" << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::ifstream f(argv[1]);
+  if (!f.is_open()) {
+    std::cerr << "Unable to open " << argv[1] << std::endl;
+    return EXIT_FAILURE;
+  }
+  Model model(f);
+  int fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+  if (fd == -1) {
+    std::cerr << "Unable to open /dev/null" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const GlyphMode glyphModes[] = {GlyphMode::Ascii, GlyphMode::HalfBlock, GlyphMode::Braille};
+  const ColorMode colorModes[] = {ColorMode::None, ColorMode::Palette256, ColorMode::TrueColor};
+  const RenderMode renderModes[] = {RenderMode::RayCast, RenderMode::Packet, RenderMode::Raster};
+  int failures = 0;
+  for (GlyphMode glyphs : glyphModes) {
+    for (ColorMode colors : colorModes) {
+      for (RenderMode mode : renderModes) {
+        for (bool extras : {false, true}) {
+          unsigned long count = countAllocations(model, fd, glyphs, colors, mode, extras);
+          if (count != 0) {
+            std::cerr << "Glyph mode " << static_cast<int>(glyphs) << ", colour mode " << static_cast<int>(colors)
+                      << ", render mode " << static_cast<int>(mode) << (extras ? " with shadows and outlines" : "")
+                      << ": " << count << " allocations in " << ALLOC_FRAMES << " frames" << std::endl;
+            failures++;
+          }
+        }
+      }
+    }
+  }
+  close(fd);
+  if (failures > 0) {
+    return EXIT_FAILURE;
+  }
+  std::cout << "No allocations in " << ALLOC_FRAMES << " frames of any combination" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -1,21 +1,135 @@
+#include <chrono>
+#include <csignal>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <fstream>
+#include <memory>
 #include <thread>
+#include <unistd.h>
 #include "Classes/Model.h"
 #include "Classes/Camera.h"
+#include "Classes/Presenter.h"
+#include "Classes/Benchmark.h"
+#include "Classes/QualityController.h"
+#include "Classes/Recorder.h"
+#include "Classes/Player.h"
+#include "Classes/Batch.h"
+#include "Classes/RenderServer.h"
+
+// Set by Ctrl-C, so the render loop ends and the recording gets its index, or the server or client shuts down
+static volatile std::sig_atomic_t interrupted = 0;
+
+static void onInterrupt(int) {
+  interrupted = 1;
+}
+
+int main(int argc, char **argv){
+  std::ios::sync_with_stdio(false);
+    // --bench [file.obj ...] compares the ray accelerators instead of rendering
+    if (argc > 1 && std::strcmp(argv[1], "--bench") == 0) {
+        std::vector<std::string> paths(argv + 2, argv + argc);
+        if (paths.empty()) {
+            paths = {"../Assets/Cube.obj", "../Assets/Face.obj", "../Assets/Ico.obj"};
+        }
+        return runBenchmark(paths);
+    }
 
-/*
-TODO take into account:
-    Sobel Filter for edge detection
-
-
+    // --half-blocks and --braille trace several samples per cell and draw them as Unicode glyphs;
+    // --256-color and --truecolor also draw the shading in colour;
+    // --fps N and --budget KB set the frame rate and kilobytes per second the quality is adapted to;
+    // --record FILE also saves the frames, which --play FILE [--seek SECONDS] shows again without rendering;
+    // --batch PATTERN [--frames FIRST-LAST] [--size WxH] renders frames to .txt, .pgm or .ppm files instead;
+    // --serve SOCKET loads the model once for any number of --connect SOCKET viewers;
+    // --shadows lets the model shadow itself and --outlines draws its silhouettes and creases as lines;
+    // --raster and --raycast find the visible surfaces by rasterizing or with single rays instead of packets;
+    // --grid traces through a uniform grid instead of the BVH, which suits meshes that deform
+    GlyphMode glyphs = GlyphMode::Ascii;
+    ColorMode colors = ColorMode::None;
+    double fps = QUALITY_FPS;
+    double budget = 0;
+    const char *recordPath = nullptr;
+    const char *playPath = nullptr;
+    double seek = 0;
+    BatchJob batch;
+    bool batching = false;
+    const char *servePath = nullptr;
+    const char *connectPath = nullptr;
+    RenderMode mode = RenderMode::Packet;
+    bool grid = false;
+    bool shadows = false;
+    bool outlines = false;
+    for (int a = 1; a < argc; a++) {
+        if (std::strcmp(argv[a], "--half-blocks") == 0) {
+            glyphs = GlyphMode::HalfBlock;
+        } else if (std::strcmp(argv[a], "--braille") == 0) {
+            glyphs = GlyphMode::Braille;
+        } else if (std::strcmp(argv[a], "--256-color") == 0) {
+            colors = ColorMode::Palette256;
+        } else if (std::strcmp(argv[a], "--truecolor") == 0) {
+            colors = ColorMode::TrueColor;
+        } else if (std::strcmp(argv[a], "--raster") == 0) {
+            mode = RenderMode::Raster;
+        } else if (std::strcmp(argv[a], "--raycast") == 0) {
+            mode = RenderMode::RayCast;
+        } else if (std::strcmp(argv[a], "--grid") == 0) {
+            grid = true;
+        } else if (std::strcmp(argv[a], "--shadows") == 0) {
+            shadows = true;
+        } else if (std::strcmp(argv[a], "--outlines") == 0) {
+            outlines = true;
+        } else if (std::strcmp(argv[a], "--fps") == 0 && a + 1 < argc && std::atof(argv[a + 1]) > 0) {
+            fps = std::atof(argv[++a]);
+        } else if (std::strcmp(argv[a], "--budget") == 0 && a + 1 < argc && std::atof(argv[a + 1]) > 0) {
+            budget = std::atof(argv[++a]) * 1024;
+        } else if (std::strcmp(argv[a], "--record") == 0 && a + 1 < argc) {
+            recordPath = argv[++a];
+        } else if (std::strcmp(argv[a], "--play") == 0 && a + 1 < argc) {
+            playPath = argv[++a];
+        } else if (std::strcmp(argv[a], "--seek") == 0 && a + 1 < argc) {
+            seek = std::atof(argv[++a]);
+        } else if (std::strcmp(argv[a], "--batch") == 0 && a + 1 < argc) {
+            batch.pattern = argv[++a];
+            batching = true;
+        } else if (std::strcmp(argv[a], "--frames") == 0 && a + 1 < argc) {
+            unsigned int first, last;
+            if (std::sscanf(argv[++a], "%u-%u", &first, &last) != 2 || last < first) {
+                std::cerr << "Expected --frames FIRST-LAST" << std::endl;
+                return EXIT_FAILURE;
+            }
+            batch.first = first;
+            batch.count = last - first + 1;
+        } else if (std::strcmp(argv[a], "--size") == 0 && a + 1 < argc) {
+            if (std::sscanf(argv[++a], "%dx%d", &batch.width, &batch.height) != 2 || batch.width <= 0 ||
+                batch.height <= 0) {
+                std::cerr << "Expected --size WIDTHxHEIGHT" << std::endl;
+                return EXIT_FAILURE;
+            }
+        } else if (std::strcmp(argv[a], "--serve") == 0 && a + 1 < argc) {
+            servePath = argv[++a];
+        } else if (std::strcmp(argv[a], "--connect") == 0 && a + 1 < argc) {
+            connectPath = argv[++a];
+        } else {
+            std::cerr << "Unknown option " << argv[a] << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
 
+    if (connectPath) {
+        std::signal(SIGINT, onInterrupt);
+        return runClient(connectPath, glyphs, colors, interrupted);
+    }
 
-*/
+    if (playPath) {
+        Player player(playPath);
+        if (!player.isOpen()) {
+            return EXIT_FAILURE;
+        }
+        std::cout.flush();
+        return player.play(STDOUT_FILENO, player.frameAtTime(seek)) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
 
-int main(){
-  std::ios::sync_with_stdio(false);
     std::ifstream f("../Assets/Cube.obj");
     if (!f.is_open()){
         std::cerr << "Unable to open file" << std::endl;
@@ -23,16 +137,66 @@ int main(){
     }
 
     Model m(f);
+    if (grid) {
+        m.setAccelerator(Accelerator::Grid);
+    }
+
+    if (batching) {
+        batch.glyphs = glyphs;
+        batch.mode = mode;
+        batch.shadows = shadows;
+        batch.outlines = outlines;
+        return runBatch(m, batch);
+    }
+
+    if (servePath) {
+        RenderServer server(m, servePath);
+        if (!server.isOpen()) {
+            return EXIT_FAILURE;
+        }
+        server.setRenderMode(mode);
+        server.setShadows(shadows);
+        server.setOutlines(outlines);
+        std::signal(SIGINT, onInterrupt);
+        server.run(fps, interrupted);
+        return EXIT_SUCCESS;
+    }
 
     Eigen::Vector3d origin(4,4,4);
     Camera c(m, origin);
+    c.setGlyphMode(glyphs);
+    c.setColorMode(colors);
+    c.setRenderMode(mode);
+    c.setShadows(shadows);
+    c.setOutlines(outlines);
+    Camera::watchResize();
+    std::unique_ptr<Recorder> recorder;
+    if (recordPath) {
+        recorder.reset(new Recorder(recordPath));
+        if (!recorder->isOpen()) {
+            return EXIT_FAILURE;
+        }
+    }
+    std::signal(SIGINT, onInterrupt);
+    Presenter p(STDOUT_FILENO);
+    QualityController q(fps, budget, colors);
 
-    while(true){
-      std::cout << "\033[2J\033[H";
+    while(!interrupted){
+      auto start = std::chrono::steady_clock::now();
       c.rayTrace();
-      c.print();
+      std::chrono::duration<double> render = std::chrono::steady_clock::now() - start;
+      if (recorder) {
+          recorder->add(c.canvas());  // Before the presenter takes the frame away
+      }
+      p.submit(c.canvas());
       m.rotate (M_PI/20);
-      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+      // Lower the quality when rendering or the terminal falls behind, and raise it again once they keep up
+      if (q.update(render.count(), p)) {
+          c.setRenderScale(q.renderScale());
+          c.setColorMode(q.colorMode());
+      }
+      std::this_thread::sleep_until(start + std::chrono::duration<double>(q.frameInterval()));
     }
     std::cout << std::endl;
 
@@ -42,7 +206,6 @@ int main(){
 
 
 //TODO calculate normals
-//TODO "brightness" of letters (is there a better font?)
 
     return EXIT_SUCCESS;
 }
\ No newline at end of file